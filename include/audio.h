@@ -0,0 +1,66 @@
+/*************************************************************
+************************* DEFINITIONS ************************
+**************************************************************/
+
+#ifndef AUDIO_H
+#define AUDIO_H
+
+// Audio-reactive colour mode, enabled with -D ENABLE_AUDIO_MODE in platformio.ini.
+// A microphone module (or a line input biased to mid-rail) on AUDIO_ADC_PIN is sampled by the continuous ADC
+// driver: the ADC's own timer paces the conversions and DMA fills whole frames, so the sample rate is fixed no
+// matter what the CPU is doing. The audio task windows each frame, runs an ESP-DSP FFT (the ESP32-S3 build uses
+// its SIMD kernels) and sums the spectrum into three bands - bass drives red, mids green and treble blue. Each
+// frame's colour is handed to the loop task as an event and crossfaded on by the fade engine over one frame time.
+//
+// The ADC only runs in audio mode, and the chip stays out of light sleep while it does.
+
+#ifdef ENABLE_AUDIO_MODE
+
+#include <Arduino.h>
+#include <atomic>
+
+#include "state.h"
+
+// Define the audio input (ADC1 channel 9 - a free pin on the header, away from the LED and the panel bus)
+#define AUDIO_ADC_PIN 10
+#define AUDIO_ADC_UNIT ADC_UNIT_1
+#define AUDIO_ADC_CHANNEL ADC_CHANNEL_9
+#define AUDIO_ADC_ATTEN ADC_ATTEN_DB_11   // full scale of about 3.1 V
+
+// Define the sampling and the spectrum frames
+#define AUDIO_SAMPLE_RATE 20480           // Hz, paced by the ADC timer (bins are 40 Hz wide)
+#define AUDIO_FFT_SIZE 512                // samples per frame (a power of two)
+#define AUDIO_FRAME_TIME (AUDIO_FFT_SIZE * 1000 / AUDIO_SAMPLE_RATE) // ms per frame (25 ms, 40 frames a second)
+#define AUDIO_DMA_FRAMES 4                // frames the driver buffers before one is dropped (100 ms of slack)
+
+// Define the colour bands (upper edge of each in Hz - red starts above DC)
+#define AUDIO_BASS_MAX_HZ 250             // red
+#define AUDIO_MID_MAX_HZ 2000             // green
+#define AUDIO_TREBLE_MAX_HZ 8000          // blue
+
+// Define the automatic gain (each band is shown relative to its own recent peak)
+#define AUDIO_PEAK_DECAY 0.995f           // per frame fall of each band's peak (halves in about 3.5 s)
+#define AUDIO_NOISE_FLOOR 2.0f            // smallest peak a band is scaled to, so silence stays dark
+
+// Define the audio task
+#define AUDIO_TASK_CORE 1                 // with the loop task, away from the display task's long transfers
+#define AUDIO_TASK_PRIORITY 3             // above the loop task, so a slow event batch never holds up a frame
+#define AUDIO_TASK_STACK_SIZE 4096
+
+extern std::atomic<uint32_t> audioFrames;   // spectrum frames processed since boot
+extern std::atomic<uint32_t> audioOverruns; // frames the ADC driver dropped because the task fell behind
+
+
+/*************************************************************
+********************** HELPER FUNCTIONS **********************
+**************************************************************/
+
+// Function to start the audio task (call once from setup() - the ADC stays off until audio mode is entered)
+void startAudio();
+
+// Function to start or stop sampling (the loop task calls this on every mode change)
+void setAudioSampling(bool on);
+
+#endif // ENABLE_AUDIO_MODE
+
+#endif // AUDIO_H
@@ -0,0 +1,167 @@
+/*************************************************************
+************************* DEFINITIONS ************************
+**************************************************************/
+
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+// Display module - the display task and everything it draws: the static layout, the cached dynamic fields,
+// the colour swatch and the hardware-scrolled colour history, plus the backlight and its idle timeouts.
+// The loop task only talks to it through publishDisplayState().
+
+#include <atomic>
+#include <Arduino.h>
+#include <TFT_eSPI.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+
+#include "state.h"
+
+// Define the display pins
+#define PIN_LCD_BL 38   // backlight pin for T-Display S3
+#define PIN_POWER_ON 15 // LCD power enable (must be HIGH for the panel to work on battery)
+
+// Define the low power idle settings
+#define BACKLIGHT_DIM_TIMEOUT 15000 // ms without button activity before the backlight dims
+#define BACKLIGHT_OFF_TIMEOUT 30000 // ms without button activity before the backlight switches off
+#define BACKLIGHT_DIM_LEVEL 64      // backlight level when dimmed (0-255, perceived brightness)
+
+// Define the backlight stages of the low power idle mode
+enum class Backlight {
+  ON,
+  DIM,
+  OFF
+};
+
+// Define the display task (input and LED control stay on the Arduino loop task, on the other core)
+#define DISPLAY_TASK_CORE 0           // the Arduino loop task runs on ARDUINO_RUNNING_CORE (1)
+#define DISPLAY_TASK_PRIORITY 1
+#define DISPLAY_TASK_STACK_SIZE 4096
+
+// Snapshot of everything the display shows, passed from the input/LED task to the display task
+struct DisplayState {
+  State mode;
+  const char* colourName; // name of the sequence step shown on the LED
+  RGBColour rgb;
+  bool buttonPressed;
+  uint8_t rotation;    // ROTATION_PORTRAIT or ROTATION_LANDSCAPE
+  int64_t eventTimeUs; // esp_timer time (us) of the oldest event behind this snapshot
+  // For status reports from other tasks (copied, as the loop task may change them at any time)
+  char sequenceName[SEQUENCE_NAME_SIZE];
+  uint16_t autoPeriodMs;
+  uint8_t brightness;
+};
+
+// Define the layout (widget bounds are computed once per rotation - see computeLayout() in display.cpp)
+#define FIELD_X 50                 // x position of the dynamic text (the field labels take the space to its left)
+#define FIELD_WIDTH 120            // width cleared before a field is redrawn (to the right edge of the portrait screen)
+#define FIELD_HEIGHT 16            // height of font 2
+#define TITLE_WIDTH TFT_WIDTH      // title block (three lines of font 2), fits the short side of the panel
+#define TITLE_HEIGHT 48
+#define PORTRAIT_ROW_Y 70          // top of the Mode row in portrait
+#define PORTRAIT_ROW_PITCH 30      // Mode, Colour and Button rows are this far apart in portrait
+#define LANDSCAPE_ROW_Y 56         // the same in landscape, packed tighter to leave room for the swatch
+#define LANDSCAPE_ROW_PITCH 24
+#define SWATCH_GAP 6               // space between the Button row and the swatch
+#define OVERLAY_GAP 4              // space between the swatch and the profiling overlay
+#define OVERLAY_HEIGHT 60          // rows kept for the profiling overlay (left out if they don't fit)
+
+// Define the widgets the layout places - the static ones are blitted from the static layer, the others
+// redraw only their own bounds
+enum Widget {
+  WIDGET_TITLE,
+  WIDGET_MODE_LABEL,
+  WIDGET_COLOUR_LABEL,
+  WIDGET_BUTTON_LABEL,
+  WIDGET_MODE,
+  WIDGET_COLOUR,
+  WIDGET_BUTTON,
+  WIDGET_SWATCH,
+  WIDGET_HISTORY,
+  WIDGET_OVERLAY,   // empty if there is no room for it
+  WIDGET_COUNT
+};
+
+#define STATIC_WIDGET_COUNT (WIDGET_BUTTON_LABEL + 1) // the title and the three field labels
+
+// A widget's bounds in screen coordinates
+struct Rect {
+  int16_t x;
+  int16_t y;
+  int16_t w;
+  int16_t h;
+};
+
+// Widget bounds for one rotation
+struct Layout {
+  uint8_t rotation;
+  bool landscape;    // the history's panel rows then run down the screen instead of across it
+  int16_t width;
+  int16_t height;
+  Rect widgets[WIDGET_COUNT];
+  Rect dynamicArea;  // the Mode, Colour and Button fields together (one frame for the sprite renderer)
+};
+
+// Define the label cache (every string a dynamic field can show, rasterised once at boot)
+#define LABEL_CACHE_SIZE 32                                // mode names, button states and every sequence step name
+#define LABEL_BYTES (FIELD_WIDTH * FIELD_HEIGHT * 2)       // one RGB565 field, background included (3840 bytes)
+
+// Define the colour swatch and history (drawn straight onto the panel, below the dynamic fields)
+#define SWATCH_HEIGHT 20             // live swatch showing the RGB value being driven
+#define SWATCH_FRAME_INTERVAL 16     // ms between swatch updates while a fade is running (~60 Hz)
+#define HISTORY_Y 240                // first panel row of the history area, which runs to the end of the panel
+#define HISTORY_HEIGHT (TFT_HEIGHT - HISTORY_Y)
+#define HISTORY_STRIP_HEIGHT 8       // rows per history entry
+#define HISTORY_LENGTH (HISTORY_HEIGHT / HISTORY_STRIP_HEIGHT) // entries shown (10)
+static_assert(HISTORY_HEIGHT % HISTORY_STRIP_HEIGHT == 0, "history strips must exactly fill the scroll area");
+
+// ST7789 vertical scrolling commands (the scroll axis is the long side of the panel - vertical in portrait,
+// horizontal in landscape)
+#ifndef ST7789_VSCRDEF
+#define ST7789_VSCRDEF 0x33  // scroll area definition (top fixed rows, scrolling rows, bottom fixed rows)
+#endif
+#ifndef ST7789_VSCRSADD
+#define ST7789_VSCRSADD 0x37 // frame memory row shown at the top of the scroll area
+#endif
+
+extern QueueHandle_t displayQueue;       // single-slot mailbox holding the latest DisplayState
+extern std::atomic<bool> displayBusy;    // true while the display task is rendering a snapshot
+extern std::atomic<bool> displayReady;   // set once the display task has initialised the panel and backlight
+extern DisplayState latestState;         // copy of the last snapshot, for status reports from other tasks
+extern portMUX_TYPE statusLock;
+extern Layout layout;                    // widget bounds for the current rotation (display task only)
+
+// Colour history ring buffer (the newest entry is just before historyHead)
+extern int historyHead;
+extern int historyCount;
+
+
+/*************************************************************
+********************** HELPER FUNCTIONS **********************
+**************************************************************/
+
+// Rendering (display task)
+void runDisplaySelfTest(TFT_eSPI &tft);
+void invalidateDynamicElements();
+const char* modeName(State mode);
+const char* buttonStateName(bool pressed);
+void buildLabelCache(TFT_eSPI &tft);
+void buildStaticLayer(TFT_eSPI &tft);
+void drawStaticElements(TFT_eSPI &tft, bool clearScreen = true);
+void setupRenderer(TFT_eSPI &tft);
+void applyRotation(TFT_eSPI &tft, uint8_t rotation);
+void updateDynamicElements(TFT_eSPI &tft, const DisplayState &state);
+void setupColourHistory(TFT_eSPI &tft);
+void updateColourPreview(TFT_eSPI &tft, const DisplayState &state);
+void initDisplay(TFT_eSPI &tft);
+void renderDisplayState(TFT_eSPI &tft, const DisplayState &state);
+void startDisplayTask(TFT_eSPI &tft);
+
+// Snapshots and backlight (loop task)
+void publishDisplayState(int64_t eventTimeUs);
+void setupBacklight();
+void setBacklightLevel(uint8_t level);
+void refreshBacklight();
+uint32_t updateBacklight();
+
+#endif // DISPLAY_H
@@ -0,0 +1,67 @@
+/*************************************************************
+************************* DEFINITIONS ************************
+**************************************************************/
+
+#ifndef FLEET_SYNC_H
+#define FLEET_SYNC_H
+
+// Fleet synchronisation over ESP-NOW, enabled with -D ENABLE_FLEET_SYNC in platformio.ini.
+// One board (built with -D FLEET_SYNC_LEADER) broadcasts a small beacon every FLEET_BEACON_INTERVAL ms saying which
+// sequence it plays, which step it is on and how long that step still has to run. Every other board follows it:
+// the Wi-Fi task's receive callback keeps the beacon and the loop task (which owns the mode and the sequence) checks
+// it against the local auto colour schedule. A small phase error is handed to the scheduler as a nudge that it works
+// off a few percent of a step at a time (see AUTO_SLEW_PER_MILLE), so the steps line up without a visible jump. Only
+// a large error (a board that just booted, changed sequence or lost the leader for a while) restarts the schedule on
+// the leader's step.
+//
+// Sync only applies in auto and fade mode while the leader plays a built-in sequence - manual and audio mode, and
+// uploaded sequences, run on their own. The radio has to stay on, so the sync builds don't light sleep.
+
+#ifdef ENABLE_FLEET_SYNC
+
+#include <Arduino.h>
+#include <atomic>
+
+#include "state.h"
+
+// Define the beacons
+#define FLEET_BEACON_MAGIC 0xC5       // first byte of every beacon (change it when the FleetBeacon layout changes)
+#define FLEET_BEACON_INTERVAL 1000    // ms between the leader's beacons
+#define FLEET_CHANNEL 1               // Wi-Fi channel (remote control builds use the access point's channel instead)
+#define FLEET_LINK_LATENCY_US 600     // typical time from the leader's send to a follower's receive callback
+
+// Define the follower's phase lock
+#define FLEET_LOCK_WINDOW_US 200000   // larger phase errors restart the schedule on the leader's step, smaller ones
+                                      // are slewed out by the scheduler
+
+// Beacon sent by the leader (explicitly padded so every build agrees on the layout)
+struct FleetBeacon {
+  uint8_t magic;        // FLEET_BEACON_MAGIC
+  uint8_t sequence;     // index into sequences[]
+  uint8_t step;         // step of that sequence on the leader's LED
+  uint8_t count;        // beacon number (wraps), so followers can tell lost beacons apart
+  uint32_t remainingUs; // time the step still had to run when the beacon was sent
+  uint16_t periodMs;    // the leader's auto period (0 = each step's own period)
+  uint8_t reserved[2];
+};
+static_assert(sizeof(FleetBeacon) == 12, "FleetBeacon must not change size between builds");
+
+extern std::atomic<uint32_t> fleetBeacons;     // beacons sent (leader) or accepted (follower) since boot
+extern std::atomic<uint32_t> fleetAlignments;  // times a follower restarted its schedule on the leader's step
+extern std::atomic<int32_t> fleetPhaseError;   // follower's phase error at the last beacon in us (positive = behind)
+
+
+/*************************************************************
+********************** HELPER FUNCTIONS **********************
+**************************************************************/
+
+// Function to start ESP-NOW and the leader's beacons or the follower's receive callback (call once from setup())
+void startFleetSync();
+
+// Function to check the leader's latest beacon against the local schedule (loop task, on a FLEET_BEACON event) -
+// nudges the scheduler, or realigns when the error is too large to slew out
+void handleFleetBeacon();
+
+#endif // ENABLE_FLEET_SYNC
+
+#endif // FLEET_SYNC_H
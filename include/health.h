@@ -0,0 +1,83 @@
+/*************************************************************
+************************* DEFINITIONS ************************
+**************************************************************/
+
+#ifndef HEALTH_H
+#define HEALTH_H
+
+// Health monitor, always built in - bounds how long the loop and display tasks may take, so a stalled panel
+// transfer or a runaway handler shows up (and is recovered from) instead of silently freezing the board.
+//   Deadlines - one event dispatch batch (input), an LED step from its timer firing to the colour being on the LED,
+//               and one rendered frame each have a limit. Every miss is counted, with the worst time seen, and
+//               reported over serial (profiling builds) and in the remote status.
+//   Watchdog  - every long-running task (loop, display, serial console, and the audio, remote control and LED strip
+//               tasks in the builds that have them) is subscribed to the ESP task watchdog and feeds it once per
+//               pass. Their blocking waits are capped at HEALTH_FEED_INTERVAL, so only a task that is really stuck
+//               (for HEALTH_WATCHDOG_TIMEOUT) resets the board - the reset reason is then in the telemetry log.
+//   Degraded  - when HEALTH_DEGRADE_MISSES frames in a row overrun, the display falls back to text-only rendering
+//               (the three fields as plain text - no bitmaps, sprite, swatch or history) at most every
+//               HEALTH_DEGRADED_FRAME_INTERVAL ms. After HEALTH_RECOVER_FRAMES frames in a row on time, full
+//               rendering comes back.
+
+#include <Arduino.h>
+#include <atomic>
+
+// Define the deadlines
+#define HEALTH_INPUT_DEADLINE 10   // ms one event dispatch batch may take
+#define HEALTH_LED_DEADLINE 5      // ms from an LED step's timer firing to the colour being on the LED
+#define HEALTH_FRAME_DEADLINE 40   // ms one rendered frame may take
+
+// Define the watchdog
+#define HEALTH_WATCHDOG_TIMEOUT 5000 // ms a subscribed task may go without feeding the task watchdog
+#define HEALTH_FEED_INTERVAL 2000    // longest idle wait of a subscribed task in ms (well inside the timeout)
+
+// Define the degraded rendering mode
+#define HEALTH_DEGRADE_MISSES 3             // frames in a row over the deadline before rendering degrades
+#define HEALTH_RECOVER_FRAMES 20            // frames in a row on time before full rendering comes back
+#define HEALTH_DEGRADED_FRAME_INTERVAL 250  // ms between degraded frames (snapshots in between are merged)
+
+// Define the monitored deadlines
+enum HealthDeadline {
+  HEALTH_INPUT,    // dispatchEvents() (loop task)
+  HEALTH_LED_STEP, // auto colour steps and pattern ticks (loop task)
+  HEALTH_FRAME,    // renderDisplayState() (display task)
+  HEALTH_DEADLINE_COUNT
+};
+
+// One deadline and its misses (each is written by one task, and read by the others for reports)
+struct HealthMonitor {
+  const char* name;
+  uint32_t limitUs;
+  std::atomic<uint32_t> misses;
+  std::atomic<uint32_t> worstUs; // longest time seen
+};
+
+extern HealthMonitor healthMonitors[HEALTH_DEADLINE_COUNT];
+extern std::atomic<bool> displayDegraded; // the display is in the degraded text-only rendering mode
+
+
+/*************************************************************
+********************** HELPER FUNCTIONS **********************
+**************************************************************/
+
+// Function to set the task watchdog up and subscribe the loop task to it (call once from setup())
+void startHealthMonitor();
+
+// Function to subscribe the calling task to the task watchdog, to feed it (once per pass of the task's loop) and to
+// unsubscribe it (before it deletes itself)
+void watchCurrentTask();
+void feedWatchdog();
+void unwatchCurrentTask();
+
+// Function to check the time since startUs (esp_timer time) against a deadline - returns false (and counts a miss)
+// if it was overrun
+bool checkDeadline(HealthDeadline deadline, int64_t startUs);
+
+// Function to track rendered frames (display task) - returns true while rendering should be degraded
+bool reportFrame(bool onTime);
+
+// Function to print the deadlines over serial, one line each:
+// HEALTH <name> limit_us=<us> misses=<n> worst_us=<us>
+void reportHealth();
+
+#endif // HEALTH_H
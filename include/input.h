@@ -0,0 +1,130 @@
+/*************************************************************
+************************* DEFINITIONS ************************
+**************************************************************/
+
+#ifndef INPUT_H
+#define INPUT_H
+
+// Input module - the button interrupt, the gesture engine, event dispatch and the low power idle loop.
+
+#include <Arduino.h>
+
+#include "state.h"
+
+// Define the button pin
+#define BUTTON_PIN 14 // built-in 'KEY' button
+
+// Define the button handling
+#define BUTTON_TICK_INTERVAL 5     // gesture engine tick interval in ms while a gesture is in progress
+#define BUTTON_SETTLE_TIME 100     // keep ticking the gesture engine this long after the last edge (covers bounce)
+
+// Define the default gesture timing in ms (the long press time comes from the settings)
+#define GESTURE_DEBOUNCE_TIME 20        // edges this soon after an accepted one are bounce (the level is re-read after)
+#define GESTURE_MULTI_CLICK_TIME 300    // a press this soon after a release continues the same multi-press
+#define GESTURE_REPEAT_DELAY 500        // how long a press is held before hold-repeat starts
+#define GESTURE_REPEAT_INTERVAL 200     // time between hold-repeats
+
+// Define the button gestures - each handler gets the press count of the burst it belongs to (1 = first press)
+enum class Gesture : uint8_t {
+  PRESS,       // press-down, as soon as the edge is accepted
+  CLICK,       // single click - on press-down unless a MULTI_CLICK handler is attached, otherwise once no second
+               // press followed within the multi-click time
+  MULTI_CLICK, // two or more short presses in a burst (count = presses), once no further press followed
+  LONG_PRESS,  // a press held for the long press time (once per hold)
+  REPEAT,      // a press still held - every repeat interval once the repeat delay has passed
+  COUNT
+};
+
+typedef void (*GestureHandler)(uint8_t count);
+
+struct GestureTiming {
+  uint16_t debounceMs;
+  uint16_t multiClickMs;
+  uint16_t longPressMs;
+  uint16_t repeatDelayMs;
+  uint16_t repeatIntervalMs;
+};
+
+// Gesture engine for one button - fed the raw level from the edge interrupt and ticked while a gesture is in
+// progress. Edges are debounced on the leading edge (accepted at once, then bounce is ignored for the debounce
+// time), so press-down gestures fire within the edge's own dispatch.
+class ButtonGestures {
+public:
+  // Function to attach a handler to a gesture (nullptr detaches it)
+  void attach(Gesture gesture, GestureHandler handler) {
+    handlers[static_cast<int>(gesture)] = handler;
+  }
+
+  // Function to change the gesture timing
+  void setTiming(const GestureTiming &newTiming) {
+    timing = newTiming;
+  }
+
+  // Function to get whether the debounced button is down, and when it last changed (esp_timer time in us)
+  bool isPressed() const {
+    return down;
+  }
+  int64_t changeTimeUs() const {
+    return changeUs;
+  }
+
+  // Function to check that nothing is pending, so the engine needs no ticks until the next edge
+  bool isIdle() const {
+    return !down && !clickPending && raw == down;
+  }
+
+  void reset();
+  void update(bool pressed, int64_t timeUs);
+  void tick(int64_t nowUs);
+
+private:
+  void accept(bool pressed, int64_t timeUs);
+  void fire(Gesture gesture, uint8_t count);
+
+  GestureHandler handlers[static_cast<int>(Gesture::COUNT)] = {};
+  GestureTiming timing = {GESTURE_DEBOUNCE_TIME, GESTURE_MULTI_CLICK_TIME, LONG_PRESS_TIME, GESTURE_REPEAT_DELAY,
+                          GESTURE_REPEAT_INTERVAL};
+  bool raw = false;                 // level of the last edge
+  bool down = false;                // debounced level
+  int64_t changeUs = INT64_MIN / 2; // esp_timer time the debounced level last changed (long ago at power on)
+  uint8_t count = 0;                // presses in the current burst
+  bool longPressed = false;         // the current press has fired its long press
+  bool held = false;                // the current press has long pressed or repeated, so it isn't a click
+  bool clickPending = false;        // a burst of clicks is waiting out the multi-click time
+  int64_t nextRepeatUs = 0;         // esp_timer time the next hold-repeat is due
+};
+
+// Define the low power idle settings
+#define LIGHT_SLEEP_MIN_TIME 5     // don't bother entering light sleep for less than this many ms
+// Light sleep is on unless -D DISABLE_LIGHT_SLEEP is set (USB serial drops out while the chip sleeps)
+
+extern uint32_t lastButtonPressUs;         // micros() timestamp of the last press edge
+extern uint32_t lastButtonPressDurationUs; // length of the last completed press in microseconds
+extern uint32_t lastActivityTime;          // millis() time of the last button activity (for the backlight timeout)
+
+
+/*************************************************************
+********************** HELPER FUNCTIONS **********************
+**************************************************************/
+
+// Button interrupt and edges
+void setupButtonInterrupt();
+bool buttonNeedsTick(ButtonGestures &button);
+void handleButtonEdge(ButtonGestures &button, const Event &edge);
+void dispatchEvents(ButtonGestures &button);
+
+// Idle
+uint32_t nextWakeDelay(ButtonGestures &button);
+void waitForInput(uint32_t timeoutMs);
+bool canLightSleep(ButtonGestures &button);
+void enterLightSleep(uint32_t timeoutMs);
+void idleUntilNextEvent(ButtonGestures &button);
+
+// Button gestures
+void attachGestures(ButtonGestures &button);
+void onShortPress(uint8_t count);
+void onMultiClick(uint8_t count);
+void onHoldRepeat(uint8_t count);
+void onLongPressStart(uint8_t count);
+
+#endif // INPUT_H
@@ -0,0 +1,456 @@
+/*************************************************************
+************************* DEFINITIONS ************************
+**************************************************************/
+
+#ifndef LED_H
+#define LED_H
+
+// LED module - the output backends, colour and gamma tables, compiled sequence steps and the fade engine.
+// Everything on the hot path is inline here, so the state machine's colour changes compile down to the writes.
+
+#include <Arduino.h>
+#include <atomic>
+#include <driver/gpio.h>
+#include <driver/ledc.h>
+#include <soc/gpio_reg.h>
+#include <soc/soc_caps.h>
+#if SOC_DEDICATED_GPIO_SUPPORTED
+#include <driver/dedic_gpio.h>
+#endif
+#ifdef LED_OUTPUT_STRIP
+#include <driver/rmt.h>
+#include <freertos/task.h>
+#endif
+#include <esp_idf_version.h>
+#include <esp_timer.h>
+
+#include "health.h"
+
+// Define the pins for the RGB LED
+#define RED_PIN 1
+#define GREEN_PIN 2
+#define BLUE_PIN 3
+
+// Define the LEDC (hardware PWM) settings for the RGB LED
+#define LED_PWM_FREQ 5000                                  // PWM frequency in Hz
+#define LED_PWM_RESOLUTION 10                              // duty resolution in bits (8-12)
+#define LED_PWM_MAX_DUTY ((1 << LED_PWM_RESOLUTION) - 1)  // duty value for a fully-on channel
+#define LED_PWM_TIMER LEDC_TIMER_0
+#define LED_PWM_MODE LEDC_LOW_SPEED_MODE                   // the S3 only has low speed channels
+#define RED_CHANNEL LEDC_CHANNEL_0
+#define GREEN_CHANNEL LEDC_CHANNEL_1
+#define BLUE_CHANNEL LEDC_CHANNEL_2
+#define BACKLIGHT_CHANNEL LEDC_CHANNEL_3 // shares the LED timer
+
+// Define the on/off GPIO output path (-D LED_OUTPUT_GPIO replaces PWM with plain on/off pins, no fades;
+// add -D LED_OUTPUT_GPIO_ARDUINO to use digitalWrite instead of the single-write fast path)
+#define LED_GPIO_THRESHOLD 128 // colour level at or above which a channel is switched on
+#define LED_GPIO_ALL_PINS ((1U << RED_PIN) | (1U << GREEN_PIN) | (1U << BLUE_PIN))
+static_assert(RED_PIN < 32 && GREEN_PIN < 32 && BLUE_PIN < 32, "LED pins must be in the first GPIO bank (GPIO0-31)");
+
+// Define the addressable strip output (-D LED_OUTPUT_STRIP drives WS2812/SK6812 pixels over RMT instead)
+#define LED_STRIP_PIN 16             // strip data pin
+#define LED_STRIP_PIXELS 144         // every pixel shows the current colour
+#define LED_STRIP_CHANNEL RMT_CHANNEL_0
+#define LED_STRIP_RESET_TIME 300     // idle time (us) the pixels need to latch a frame (WS2812B needs >280 us)
+#define LED_STRIP_TASK_CORE 1        // with the loop task, which does most of the writes
+#define LED_STRIP_TASK_PRIORITY 5    // above the loop task, so a staged colour goes out without waiting for it
+#define LED_STRIP_TASK_STACK_SIZE 2048
+
+// LEDC keeps running through light sleep only when clocked from the internal fast RC oscillator
+#if ESP_IDF_VERSION_MAJOR >= 5
+#define LED_PWM_SLEEP_CLK LEDC_USE_RC_FAST_CLK
+#define LED_PWM_SLEEP_PD_DOMAIN ESP_PD_DOMAIN_RC_FAST
+#else
+#define LED_PWM_SLEEP_CLK LEDC_USE_RTC8M_CLK
+#define LED_PWM_SLEEP_PD_DOMAIN ESP_PD_DOMAIN_RTC8M
+#endif
+
+// Define the fade engine (crossfades are stepped from an esp_timer, not from loop())
+#define FADE_FRAME_INTERVAL 10 // time between fade updates in ms (100 Hz)
+
+// 24-bit colour value (8 bits per channel)
+struct RGBColour {
+  uint8_t r;
+  uint8_t g;
+  uint8_t b;
+};
+
+// Lookup table from 8-bit perceived lightness to LEDC duty (CIE 1931 lightness curve)
+struct DutyTable {
+  uint16_t duty[256];
+};
+
+// Function to build the lightness-to-duty table (evaluated at compile time)
+constexpr DutyTable makeCIETable() {
+  DutyTable table = {};
+  for (int i = 0; i < 256; i++) {
+    double lightness = i * 100.0 / 255.0; // L* from 0 to 100
+    double luminance = (lightness <= 8.0) ? lightness / 903.3
+                                          : ((lightness + 16.0) / 116.0) * ((lightness + 16.0) / 116.0) * ((lightness + 16.0) / 116.0);
+    table.duty[i] = static_cast<uint16_t>(luminance * LED_PWM_MAX_DUTY + 0.5);
+  }
+  return table;
+}
+
+inline constexpr DutyTable cieTable = makeCIETable();
+
+// Function to convert an 8-bit colour level to an LEDC duty value (gamma corrected, so levels look evenly spaced)
+constexpr uint16_t levelToDuty(uint8_t level) {
+  return cieTable.duty[level];
+}
+
+// Lookup table from colour level to LED duty at the current LED brightness - the brightness is folded into the
+// table when it changes (see setLEDBrightness()), so the output backends never scale on the hot path
+extern std::atomic<const DutyTable*> ledDutyTable;
+
+// Function to get the LED output table for the current brightness (only from the LED writes, which led.cpp runs
+// under its fadeLock - setLEDBrightness() swaps tables under the same lock)
+inline const DutyTable &ledTable() {
+  return *ledDutyTable.load(std::memory_order_acquire);
+}
+
+// Function to convert a fixed-point 8.8 colour level to a duty value from a table (interpolates between entries)
+inline uint16_t fixedLevelToDuty(const DutyTable &table, uint16_t level) {
+  uint8_t index = level >> 8;
+  uint32_t fraction = level & 0xFF;
+  if (index == 255) {
+    return table.duty[255];
+  }
+  return table.duty[index] + (((table.duty[index + 1] - table.duty[index]) * fraction) >> 8);
+}
+
+// Define how the LED moves into a sequence step
+enum class Transition : uint8_t {
+  CUT,  // jump straight to the new colour
+  FADE  // crossfade from the previous colour
+};
+
+// One step of a colour sequence, as written in the tables below
+struct SequenceStep {
+  RGBColour colour;
+  uint16_t durationMs;   // how long the step is shown in auto mode
+  Transition transition;
+  const char* name;      // shown on the display
+};
+
+// One step of a colour sequence, compiled down to the values written on the hot path
+struct PackedStep {
+  uint8_t onMask;        // channels that are on in GPIO output mode (bit 0 red, bit 1 green, bit 2 blue)
+  uint32_t setMask;      // GPIO_OUT_W1TS value for GPIO output mode
+  uint32_t clearMask;    // GPIO_OUT_W1TC value for GPIO output mode
+  uint16_t durationMs;
+  Transition transition;
+  RGBColour colour;
+  const char* name;
+};
+
+template <size_t N>
+struct PackedSequence {
+  PackedStep steps[N];
+};
+
+// Function to get which channels are on for a colour in GPIO output mode
+constexpr uint8_t colourOnMask(const RGBColour &colour) {
+  return (colour.r >= LED_GPIO_THRESHOLD ? 1 : 0) | (colour.g >= LED_GPIO_THRESHOLD ? 2 : 0) |
+         (colour.b >= LED_GPIO_THRESHOLD ? 4 : 0);
+}
+
+// Function to convert a channel on mask to the matching GPIO set register mask
+constexpr uint32_t onMaskToPins(uint8_t onMask) {
+  return ((onMask & 1) ? 1U << RED_PIN : 0) | ((onMask & 2) ? 1U << GREEN_PIN : 0) | ((onMask & 4) ? 1U << BLUE_PIN : 0);
+}
+
+// Function to compile one sequence step into packed output values
+constexpr PackedStep packStep(const SequenceStep &step) {
+  uint8_t onMask = colourOnMask(step.colour);
+  return {
+    onMask, onMaskToPins(onMask), LED_GPIO_ALL_PINS & ~onMaskToPins(onMask),
+    step.durationMs, step.transition, step.colour, step.name
+  };
+}
+
+// Function to compile a table of sequence steps into packed output values (evaluated at compile time)
+template <size_t N>
+constexpr PackedSequence<N> packSequence(const SequenceStep (&steps)[N]) {
+  PackedSequence<N> packed = {};
+  for (size_t i = 0; i < N; i++) {
+    packed.steps[i] = packStep(steps[i]);
+  }
+  return packed;
+}
+
+/*************************************************************
+******************** LED OUTPUT BACKENDS *********************
+**************************************************************/
+
+// Every backend has the same static interface, and the one used is picked at compile time (LEDOutput below),
+// so calls through it inline straight to the hardware writes:
+//   canFade           - whether the fade engine can drive it
+//   begin()           - set up the pins/peripheral
+//   writeStep(step)   - show a precompiled sequence step
+//   writeLevels(lvl)  - show 8.8 fixed-point levels (used by the fade engine)
+//   writeColour(rgb)  - show any 24-bit colour
+//   flush()           - send what the writes above staged (called after them, outside any critical section)
+// The write functions only touch registers or memory, so the fade engine can call them under its spinlock.
+// The PWM and strip backends take their duty from ledDutyTable, so they follow the LED brightness; on/off GPIO
+// pins can't be dimmed and ignore it.
+
+// LEDC backend - one hardware PWM channel per LED pin (default)
+struct LEDCOutput {
+  static constexpr bool canFade = true;
+
+  // Function to set up one PWM channel per LED pin (the shared LEDC timer must already be set up)
+  static void begin() {
+    const int pins[] = {RED_PIN, GREEN_PIN, BLUE_PIN};
+    const ledc_channel_t channels[] = {RED_CHANNEL, GREEN_CHANNEL, BLUE_CHANNEL};
+
+    for (int i = 0; i < 3; i++) {
+      ledc_channel_config_t channelConfig = {};
+      channelConfig.gpio_num = pins[i];
+      channelConfig.speed_mode = LED_PWM_MODE;
+      channelConfig.channel = channels[i];
+      channelConfig.intr_type = LEDC_INTR_DISABLE;
+      channelConfig.timer_sel = LED_PWM_TIMER;
+      channelConfig.duty = 0; // start with the LED off
+      channelConfig.hpoint = 0;
+      ledc_channel_config(&channelConfig);
+    }
+  }
+
+  // Function to write precomputed duty values to the three LED channels
+  static inline void writeDuty(const uint16_t duty[3]) {
+    ledc_set_duty(LED_PWM_MODE, RED_CHANNEL, duty[0]);
+    ledc_set_duty(LED_PWM_MODE, GREEN_CHANNEL, duty[1]);
+    ledc_set_duty(LED_PWM_MODE, BLUE_CHANNEL, duty[2]);
+    ledc_update_duty(LED_PWM_MODE, RED_CHANNEL);
+    ledc_update_duty(LED_PWM_MODE, GREEN_CHANNEL);
+    ledc_update_duty(LED_PWM_MODE, BLUE_CHANNEL);
+  }
+
+  static inline void writeStep(const PackedStep &step) {
+    writeColour(step.colour); // one table lookup per channel
+  }
+
+  static inline void writeLevels(const uint16_t levels[3]) {
+    const DutyTable &table = ledTable();
+    const uint16_t duty[3] = {fixedLevelToDuty(table, levels[0]), fixedLevelToDuty(table, levels[1]),
+                              fixedLevelToDuty(table, levels[2])};
+    writeDuty(duty);
+  }
+
+  static inline void writeColour(const RGBColour &colour) {
+    const DutyTable &table = ledTable();
+    const uint16_t duty[3] = {table.duty[colour.r], table.duty[colour.g], table.duty[colour.b]};
+    writeDuty(duty);
+  }
+
+  static inline void flush() {} // the duty registers are already updated
+};
+
+// GPIO backend - plain on/off pins, all three switched together (7 colours, no fades)
+struct GPIOOutput {
+  static constexpr bool canFade = false;
+#if SOC_DEDICATED_GPIO_SUPPORTED && !defined(LED_OUTPUT_GPIO_ARDUINO)
+  static inline dedic_gpio_bundle_handle_t bundle = nullptr; // red, green, blue as bits 0-2 of a dedicated GPIO bundle
+#endif
+
+  // Function to set up the LED pins as plain on/off outputs
+  static void begin() {
+    pinMode(RED_PIN, OUTPUT);
+    pinMode(GREEN_PIN, OUTPUT);
+    pinMode(BLUE_PIN, OUTPUT);
+
+#if SOC_DEDICATED_GPIO_SUPPORTED && !defined(LED_OUTPUT_GPIO_ARDUINO)
+    // The bundle is tied to the core that creates it - call this from the task that writes the LED
+    const int pins[] = {RED_PIN, GREEN_PIN, BLUE_PIN};
+    dedic_gpio_bundle_config_t bundleConfig = {};
+    bundleConfig.gpio_array = pins;
+    bundleConfig.array_size = 3;
+    bundleConfig.flags.out_en = 1;
+    dedic_gpio_new_bundle(&bundleConfig, &bundle);
+#endif
+  }
+
+  // Function to switch the three LED pins in one go (bit 0 red, bit 1 green, bit 2 blue)
+  static inline void writeMask(uint8_t onMask, uint32_t setMask, uint32_t clearMask) {
+#if defined(LED_OUTPUT_GPIO_ARDUINO)
+    (void)setMask;
+    (void)clearMask;
+    digitalWrite(RED_PIN, (onMask & 1) ? HIGH : LOW);
+    digitalWrite(GREEN_PIN, (onMask & 2) ? HIGH : LOW);
+    digitalWrite(BLUE_PIN, (onMask & 4) ? HIGH : LOW);
+#elif SOC_DEDICATED_GPIO_SUPPORTED
+    (void)setMask;
+    (void)clearMask;
+    dedic_gpio_bundle_write(bundle, 0x7, onMask); // one CPU write - all three pins change together
+#else
+    (void)onMask;
+    REG_WRITE(GPIO_OUT_W1TC_REG, clearMask); // switch off first, so the in-between state is never a wrong colour
+    REG_WRITE(GPIO_OUT_W1TS_REG, setMask);
+#endif
+  }
+
+  static inline void writeStep(const PackedStep &step) {
+    writeMask(step.onMask, step.setMask, step.clearMask);
+  }
+
+  static inline void writeColour(const RGBColour &colour) {
+    uint8_t onMask = colourOnMask(colour);
+    writeMask(onMask, onMaskToPins(onMask), LED_GPIO_ALL_PINS & ~onMaskToPins(onMask));
+  }
+
+  static inline void writeLevels(const uint16_t levels[3]) {
+    writeColour({static_cast<uint8_t>(levels[0] >> 8), static_cast<uint8_t>(levels[1] >> 8), static_cast<uint8_t>(levels[2] >> 8)});
+  }
+
+  static inline void flush() {} // the pins are already switched
+};
+
+#ifdef LED_OUTPUT_STRIP
+// RMT backend - WS2812/SK6812 strip, every pixel showing the current colour. A write only stages the colour and
+// flush() wakes the strip task, so neither blocks its caller (the fade timer runs on the esp_timer task, which every
+// other timer shares). The strip task sends the latest staged colour once the previous frame has latched - writes
+// that arrive meanwhile are merged, the last one winning. Frames are double buffered: the next frame is composed
+// while the RMT peripheral (refilled from its interrupt) sends the previous one.
+template <int PIN, int PIXELS, rmt_channel_t CHANNEL>
+struct RMTStripOutput {
+  static constexpr bool canFade = true;
+  static constexpr int64_t frameTime = PIXELS * 30; // us on the wire (24 bits x 1.25 us per pixel)
+
+  static inline uint8_t frames[2][PIXELS * 3];      // GRB bytes (strip task only)
+  static inline int backFrame = 0;                   // frame composed next
+  static inline int64_t lastFrameStart = 0;          // esp_timer time (us) the last frame started sending
+  static inline uint8_t staged[3] = {0, 0, 0};       // latest colour written (GRB), not sent yet
+  static inline portMUX_TYPE stagedLock = portMUX_INITIALIZER_UNLOCKED; // the loop task and the fade timer write it
+  static inline TaskHandle_t task = nullptr;
+
+  // RMT translator - turns frame bytes into WS2812 bit timings (40 MHz RMT clock, 25 ns per tick)
+  static void IRAM_ATTR translate(const void* source, rmt_item32_t* dest, size_t sourceSize, size_t wantedItems,
+                                  size_t* translatedSize, size_t* itemCount) {
+    const rmt_item32_t bit0 = {{{16, 1, 34, 0}}}; // 0.4 us high, 0.85 us low
+    const rmt_item32_t bit1 = {{{32, 1, 18, 0}}}; // 0.8 us high, 0.45 us low
+    const uint8_t* bytes = static_cast<const uint8_t*>(source);
+    size_t size = 0;
+    size_t items = 0;
+
+    while (size < sourceSize && items + 8 <= wantedItems) {
+      for (int bit = 7; bit >= 0; bit--) {
+        dest->val = (bytes[size] & (1 << bit)) ? bit1.val : bit0.val;
+        dest++;
+      }
+      items += 8;
+      size++;
+    }
+    *translatedSize = size;
+    *itemCount = items;
+  }
+
+  // Strip task - sends the staged colour each time it is woken (waiting on the RMT and the latch is fine here)
+  static void stripTask(void* parameter) {
+    (void)parameter;
+    watchCurrentTask();
+    for (;;) {
+      feedWatchdog();
+      // Any number of writes since the last frame wake it once
+      if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(HEALTH_FEED_INTERVAL)) == 0) {
+        continue; // nothing written - woke up to feed the watchdog
+      }
+
+      uint8_t grb[3];
+      portENTER_CRITICAL(&stagedLock);
+      memcpy(grb, staged, sizeof(grb));
+      portEXIT_CRITICAL(&stagedLock);
+
+      uint8_t* frame = frames[backFrame];
+      for (int i = 0; i < PIXELS; i++) {
+        memcpy(&frame[i * 3], grb, sizeof(grb));
+      }
+
+      rmt_wait_tx_done(CHANNEL, portMAX_DELAY); // at most one frame time
+      int64_t wait = lastFrameStart + frameTime + LED_STRIP_RESET_TIME - esp_timer_get_time();
+      if (wait > 0) {
+        delayMicroseconds(wait);
+      }
+
+      lastFrameStart = esp_timer_get_time();
+      rmt_write_sample(CHANNEL, frame, PIXELS * 3, false); // returns straight away
+      backFrame ^= 1;
+    }
+  }
+
+  // Function to set up the RMT channel and the strip task
+  static void begin() {
+    rmt_config_t config = RMT_DEFAULT_CONFIG_TX(static_cast<gpio_num_t>(PIN), CHANNEL);
+    config.clk_div = 2; // 80 MHz APB / 2 = 40 MHz
+    rmt_config(&config);
+    rmt_driver_install(CHANNEL, 0, 0);
+    rmt_translator_init(CHANNEL, translate);
+    xTaskCreatePinnedToCore(stripTask, "strip", LED_STRIP_TASK_STACK_SIZE, nullptr, LED_STRIP_TASK_PRIORITY, &task,
+                            LED_STRIP_TASK_CORE);
+  }
+
+  // Function to stage one colour for every pixel (sent by the strip task once flush() wakes it)
+  static void show(uint8_t r, uint8_t g, uint8_t b) {
+    portENTER_CRITICAL(&stagedLock);
+    staged[0] = g;
+    staged[1] = r;
+    staged[2] = b;
+    portEXIT_CRITICAL(&stagedLock);
+  }
+
+  static inline void flush() {
+    xTaskNotifyGive(task); // never blocks
+  }
+
+  // Function to scale a gamma-corrected duty value down to an 8-bit pixel level
+  static inline uint8_t dutyToPixel(uint16_t duty) {
+    return static_cast<uint8_t>(duty >> (LED_PWM_RESOLUTION - 8));
+  }
+
+  static inline void writeStep(const PackedStep &step) {
+    writeColour(step.colour);
+  }
+
+  static inline void writeLevels(const uint16_t levels[3]) {
+    const DutyTable &table = ledTable();
+    show(dutyToPixel(fixedLevelToDuty(table, levels[0])), dutyToPixel(fixedLevelToDuty(table, levels[1])),
+         dutyToPixel(fixedLevelToDuty(table, levels[2])));
+  }
+
+  static inline void writeColour(const RGBColour &colour) {
+    const DutyTable &table = ledTable();
+    show(dutyToPixel(table.duty[colour.r]), dutyToPixel(table.duty[colour.g]), dutyToPixel(table.duty[colour.b]));
+  }
+};
+#endif // LED_OUTPUT_STRIP
+
+// Select the LED output backend (set in platformio.ini)
+#if defined(LED_OUTPUT_STRIP)
+using LEDOutput = RMTStripOutput<LED_STRIP_PIN, LED_STRIP_PIXELS, LED_STRIP_CHANNEL>;
+#elif defined(LED_OUTPUT_GPIO)
+using LEDOutput = GPIOOutput;
+#else
+using LEDOutput = LEDCOutput;
+#endif
+
+/*************************************************************
+********************** HELPER FUNCTIONS **********************
+**************************************************************/
+
+// LED output and the LEDC timer it shares with the backlight
+void setupPWMTimer();
+void setupLEDOutput();
+
+// LED brightness
+void setLEDBrightness(uint8_t brightness);
+
+// Fade engine
+void setupFadeTimer();
+void startFade(const RGBColour &target, uint32_t durationMs);
+void showColour(const RGBColour &colour);
+void showStep(const PackedStep &step);
+bool readFadeColour(RGBColour &colour);
+bool fadeRunning();
+
+#endif // LED_H
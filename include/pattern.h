@@ -0,0 +1,86 @@
+/*************************************************************
+************************* DEFINITIONS ************************
+**************************************************************/
+
+#ifndef PATTERN_H
+#define PATTERN_H
+
+// Pattern mode - colour behaviours written as a small bytecode program instead of a built-in sequence, so new ones
+// need no reflash. A pattern is read from PATTERN_FILE on the LittleFS partition at boot (pio run -t uploadfs puts
+// data/ there) or pushed with the remote "pattern" command.
+//
+// Bytecode (multi-byte values little-endian), at most PATTERN_MAX_BYTES:
+//   'P' 'T' PATTERN_VERSION    header
+//   0x01 r g b                 COLOUR - cut to a colour
+//   0x02 r g b ms(2)           FADE   - crossfade to a colour over ms (1-65535), then carry on
+//   0x03 ms(2)                 WAIT   - hold the colour for ms (1-65535)
+//   0x04 target count          LOOP   - jump to instruction <target> count more times (0 = forever), then carry on
+//   0x05 target                BUTTON - jump to instruction <target> if the button is held when this is reached
+//   0x06                       END    - stop, leaving the colour on
+// Targets are instruction numbers (from 0, not byte offsets). Running past the last instruction starts again at
+// the first. e.g. blink red twice, then fade to blue and back forever:
+//   50 54 01  01 FF 00 00  03 F4 01  01 00 00 00  03 F4 01  04 00 01  02 00 00 FF E8 03  02 FF 00 00 E8 03  04 05 00
+//
+// A pattern is checked once, when it is loaded: every operand and target must be in range, and every loop has to
+// pass a WAIT or a FADE. It is then decoded into a flat array of fixed-size instructions, so the interpreter needs
+// no parsing or allocation, and one tick runs at most PATTERN_MAX_INSTRUCTIONS of them before it waits. Ticks come
+// from an esp_timer on the same drift-free schedule as auto mode and are run on the loop task, which owns the LED.
+
+#include <Arduino.h>
+
+#include "led.h"
+#include "state.h"
+
+// Define the pattern limits and where one is stored
+#define PATTERN_MAX_INSTRUCTIONS 64
+#define PATTERN_MAX_BYTES (3 + PATTERN_MAX_INSTRUCTIONS * 6) // header and the longest instructions (FADE)
+#define PATTERN_VERSION 1
+#define PATTERN_FILE "/pattern.bin"
+
+// Define the pattern instructions (the opcode byte of each)
+enum class PatternOp : uint8_t {
+  COLOUR = 0x01,
+  FADE = 0x02,
+  WAIT = 0x03,
+  LOOP = 0x04,
+  BUTTON = 0x05,
+  END = 0x06
+};
+
+// A decoded instruction (8 bytes, the operands already in native form)
+struct PatternInstruction {
+  PatternOp op;
+  RGBColour colour;  // COLOUR and FADE
+  uint16_t argument; // duration in ms (FADE and WAIT) or the target instruction (LOOP and BUTTON)
+  uint8_t count;     // LOOP repeats (0 = forever)
+  uint8_t loopsLeft; // LOOP repeats left on the current pass (run time state)
+};
+static_assert(sizeof(PatternInstruction) == 8, "PatternInstruction should stay 8 bytes");
+
+// A decoded pattern
+struct Pattern {
+  PatternInstruction instructions[PATTERN_MAX_INSTRUCTIONS];
+  uint8_t length; // 0 = no pattern
+};
+
+
+/*************************************************************
+********************** HELPER FUNCTIONS **********************
+**************************************************************/
+
+// Loading
+bool decodePattern(const uint8_t* code, size_t length, Pattern &pattern);
+bool loadPatternFile();
+void handlePatternFile();
+bool stagePattern(const uint8_t* code, size_t length);
+void installPattern();
+bool patternLoaded();
+
+// Running
+void setupPatternTimer();
+void startPattern();
+void stopPattern();
+uint32_t nextPatternDelay();
+void handlePatternTick(const Event &event);
+
+#endif // PATTERN_H
@@ -0,0 +1,117 @@
+/*************************************************************
+************************* DEFINITIONS ************************
+**************************************************************/
+
+#ifndef PROFILING_H
+#define PROFILING_H
+
+// Hot-path timing probes, enabled with -D ENABLE_PROFILING in platformio.ini.
+// Without the flag every PROFILE_* macro compiles to nothing.
+
+#ifdef ENABLE_PROFILING
+
+#include <Arduino.h>
+#include <TFT_eSPI.h>
+#include <esp_cpu.h>
+#include <esp_idf_version.h>
+
+// Define the profiling settings
+#define PROFILE_BUCKETS 128           // histogram buckets per probe (4 per power of two of cycles)
+#define PROFILE_REPORT_INTERVAL 5000  // ms between serial reports
+#define PROFILE_OVERLAY_ROW_HEIGHT 10 // row spacing of the overlay in pixels (font 1)
+#define PROFILE_OVERLAY_INTERVAL 1000 // ms between overlay refreshes (overlay enabled with -D PROFILE_OVERLAY)
+
+// Define the timing probes
+enum ProfileId {
+  PROFILE_LOOP,        // active part of loop() (excludes idling)
+  PROFILE_BUTTON,      // button edge events and gesture ticks
+  PROFILE_AUTO_COLOUR, // auto colour step events
+  PROFILE_RENDER,      // updateDynamicElements() on the display task
+  PROFILE_LATENCY,     // event timestamp to rendered snapshot (input/timer to screen)
+  PROFILE_COUNT
+};
+
+// Timing statistics for one probe (all times in CPU cycles)
+struct Profile {
+  const char* name;
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t total;
+  uint32_t buckets[PROFILE_BUCKETS];
+};
+
+extern Profile profiles[PROFILE_COUNT];
+
+
+/*************************************************************
+********************** HELPER FUNCTIONS **********************
+**************************************************************/
+
+// Function to read the CPU cycle counter of the calling core
+inline uint32_t profileCycles() {
+#if ESP_IDF_VERSION_MAJOR >= 5
+  return esp_cpu_get_cycle_count();
+#else
+  return esp_cpu_get_ccount();
+#endif
+}
+
+// Function to map a cycle count to its histogram bucket (4 buckets per power of two)
+inline int profileBucket(uint32_t cycles) {
+  if (cycles < 4) {
+    return cycles;
+  }
+  int msb = 31 - __builtin_clz(cycles);
+  return (msb - 1) * 4 + ((cycles >> (msb - 2)) & 3);
+}
+
+// Function to get the largest cycle count that falls in a histogram bucket
+inline uint32_t profileBucketUpperBound(int bucket) {
+  if (bucket < 4) {
+    return bucket;
+  }
+  int msb = bucket / 4 + 1;
+  uint32_t lower = static_cast<uint32_t>(4 + bucket % 4) << (msb - 2);
+  return lower + ((1UL << (msb - 2)) - 1);
+}
+
+// Function to add one measurement to a probe
+inline void recordProfile(Profile &profile, uint32_t cycles) {
+  profile.count++;
+  profile.total += cycles;
+  if (cycles < profile.min) {
+    profile.min = cycles;
+  }
+  if (cycles > profile.max) {
+    profile.max = cycles;
+  }
+  profile.buckets[profileBucket(cycles)]++;
+}
+
+// Function to convert cycles to microseconds
+inline uint32_t cyclesToMicros(uint64_t cycles) {
+  return static_cast<uint32_t>(cycles / getCpuFrequencyMhz());
+}
+
+// Function to estimate the 99th percentile of a probe in cycles, and to report the probes over serial and on screen
+uint32_t profilePercentile99(const Profile &profile);
+void reportProfiles();
+void serviceProfileReport();
+void drawProfileOverlay(TFT_eSPI &tft, int32_t top); // top comes from the display layout
+
+// Start/stop a timing probe (the start and end must be in the same scope)
+#define PROFILE_START(id) uint32_t profileStart_##id = profileCycles()
+#define PROFILE_END(id) recordProfile(profiles[id], profileCycles() - profileStart_##id)
+// Record a duration measured in microseconds (e.g. between two tasks) against a probe
+#define PROFILE_RECORD_US(id, us) recordProfile(profiles[id], static_cast<uint32_t>((us) * getCpuFrequencyMhz()))
+
+#else
+
+#define PROFILE_START(id)
+#define PROFILE_END(id)
+#define PROFILE_RECORD_US(id, us)
+
+#endif // ENABLE_PROFILING
+
+#endif // PROFILING_H
@@ -0,0 +1,55 @@
+/*************************************************************
+************************* DEFINITIONS ************************
+**************************************************************/
+
+#ifndef REMOTE_CONTROL_H
+#define REMOTE_CONTROL_H
+
+// Network control over Wi-Fi, enabled with -D ENABLE_REMOTE_CONTROL in platformio.ini.
+// Commands arrive as UDP datagrams (unicast or broadcast, so one packet can drive a whole room of boards),
+// are parsed on their own task and handed to the loop task as events - the network never touches the LED,
+// the button or the display directly.
+//
+// Protocol (UDP port REMOTE_PORT) - one or more commands per datagram, separated by newlines or ';':
+//   colour <r> <g> <b>                 show a fixed colour (switches to manual mode)
+//   mode <name>                        auto, fade, manual, audio (ENABLE_AUDIO_MODE builds) or pattern (once loaded)
+//   period <ms>                        auto period for every step (0 = each step's own period)
+//   sequence <index>                   play a built-in sequence (0 basic, 1 rainbow, 2 alert)
+//   brightness <1-255>                 LED and backlight brightness (saved with the other settings)
+//   rotate portrait|landscape          turn the screen layout (saved with the other settings)
+//   upload <r>,<g>,<b>,<ms>[,fade] ... load a sequence of up to UPLOAD_MAX_STEPS steps and play it
+//   pattern <hex bytes>                load a bytecode pattern (see pattern.h) and play it - kept in RAM only
+//   status                             reply with the current state and timing metrics
+// Every datagram gets one reply: "ok", "err <command>" for the first command that failed (a mode this build or
+// board can't switch to fails too), or the status text.
+
+#ifdef ENABLE_REMOTE_CONTROL
+
+#include <Arduino.h>
+
+#include "state.h"
+
+#if !defined(WIFI_SSID) || !defined(WIFI_PASSWORD)
+#error "ENABLE_REMOTE_CONTROL needs WIFI_SSID and WIFI_PASSWORD build flags (see platformio.ini)"
+#endif
+
+// Define the remote control settings
+#define REMOTE_PORT 4210
+#define REMOTE_TASK_CORE 0            // with the Wi-Fi stack and the display - away from input and LED control
+#define REMOTE_TASK_PRIORITY 1
+#define REMOTE_TASK_STACK_SIZE 6144
+#define REMOTE_PACKET_SIZE 1024       // largest datagram accepted (a full 32-step upload fits)
+#define REMOTE_REPLY_SIZE 1024
+#define REMOTE_CONNECT_POLL 250       // ms between Wi-Fi connection checks
+
+
+/*************************************************************
+********************** HELPER FUNCTIONS **********************
+**************************************************************/
+
+// Function to start the remote control task (returns straight away - Wi-Fi connects in the background)
+void startRemoteControl();
+
+#endif // ENABLE_REMOTE_CONTROL
+
+#endif // REMOTE_CONTROL_H
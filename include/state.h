@@ -0,0 +1,236 @@
+/*************************************************************
+************************* DEFINITIONS ************************
+**************************************************************/
+
+#ifndef STATE_H
+#define STATE_H
+
+// State module - the mode state machine, colour sequences, auto colour scheduler, event bus and persisted settings.
+// Everything here is owned by the loop task; other tasks and interrupts only post events.
+
+#include <atomic>
+#include <Arduino.h>
+#include <Preferences.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "led.h"
+
+// Define the named colours of the basic palette (the first built-in sequence, in this order)
+enum class LEDColour {
+  RED,
+  GREEN,
+  BLUE,
+  YELLOW,
+  MAGENTA,
+  CYAN,
+  WHITE
+};
+
+// Define the state machine mode states
+enum class State {
+  Colour_CHANGE_AUTO,   // automatic colour change every second
+  Colour_CHANGE_MANUAL, // change colour on button press
+  Colour_CHANGE_FADE,   // automatic colour change, crossfading between every step
+  Colour_CHANGE_AUDIO,  // colour follows the spectrum of the audio input (ENABLE_AUDIO_MODE builds only)
+  Colour_CHANGE_PATTERN // colour comes from a loaded bytecode pattern (see pattern.h)
+};
+
+// Define the persisted settings (one NVS blob, written a while after the last change so bursts of presses
+// end up as a single flash write)
+#define SETTINGS_NAMESPACE "led"
+#define SETTINGS_KEY "settings"
+#define SETTINGS_VERSION 1          // bump when the Settings layout changes (older blobs are then ignored)
+#define SETTINGS_COMMIT_DELAY 3000  // ms without changes before settings are written to flash
+#define LONG_PRESS_TIME 1000        // default long press duration in ms
+
+// Define the brightness steps a double click cycles through (perceived brightness, applied to the LED and the
+// backlight alike): 255 -> 191 -> 127 -> 63 -> back to 255
+#define BRIGHTNESS_STEP 64          // each double click dims by this much
+#define BRIGHTNESS_MIN 1            // lowest brightness a command may set (0 would blank the LED and the screen)
+
+// Define the screen rotations the display layout supports (TFT_eSPI setRotation() values)
+#define ROTATION_PORTRAIT 0
+#define ROTATION_LANDSCAPE 1        // rotations 2 and 3 would reverse the history's scroll direction
+
+// Define the auto mode timing
+#define AUTO_COLOUR_PERIOD 1000 // default time each colour is shown in auto mode in ms
+#define AUTO_SLEW_PER_MILLE 20  // largest phase correction applied to one step (2% of its period), so a nudged
+                                // schedule catches up over a few steps instead of jumping
+
+// Basic palette - one step per LEDColour (same order as the enum)
+inline constexpr SequenceStep basicPaletteSteps[] = {
+  {{255,   0,   0}, AUTO_COLOUR_PERIOD, Transition::CUT, "RED"},
+  {{  0, 255,   0}, AUTO_COLOUR_PERIOD, Transition::CUT, "GREEN"},
+  {{  0,   0, 255}, AUTO_COLOUR_PERIOD, Transition::CUT, "BLUE"},
+  {{255, 255,   0}, AUTO_COLOUR_PERIOD, Transition::CUT, "YELLOW"},
+  {{255,   0, 255}, AUTO_COLOUR_PERIOD, Transition::CUT, "MAGENTA"},
+  {{  0, 255, 255}, AUTO_COLOUR_PERIOD, Transition::CUT, "CYAN"},
+  {{255, 255, 255}, AUTO_COLOUR_PERIOD, Transition::CUT, "WHITE"}
+};
+static_assert(sizeof(basicPaletteSteps) / sizeof(basicPaletteSteps[0]) == static_cast<size_t>(LEDColour::WHITE) + 1,
+              "basicPaletteSteps must have one entry per LEDColour");
+
+// Rainbow - slow crossfades around the colour wheel
+inline constexpr SequenceStep rainbowSteps[] = {
+  {{255,   0,   0}, 1500, Transition::FADE, "RED"},
+  {{255, 128,   0}, 1500, Transition::FADE, "ORANGE"},
+  {{255, 255,   0}, 1500, Transition::FADE, "YELLOW"},
+  {{  0, 255,   0}, 1500, Transition::FADE, "GREEN"},
+  {{  0,   0, 255}, 1500, Transition::FADE, "BLUE"},
+  {{128,   0, 255}, 1500, Transition::FADE, "VIOLET"}
+};
+
+// Alert - fast red/blue flashes
+inline constexpr SequenceStep alertSteps[] = {
+  {{255,   0,   0}, 250, Transition::CUT, "RED"},
+  {{  0,   0,   0}, 250, Transition::CUT, "OFF"},
+  {{  0,   0, 255}, 250, Transition::CUT, "BLUE"},
+  {{  0,   0,   0}, 250, Transition::CUT, "OFF"}
+};
+
+inline constexpr auto basicPalette = packSequence(basicPaletteSteps);
+inline constexpr auto rainbowSequence = packSequence(rainbowSteps);
+inline constexpr auto alertSequence = packSequence(alertSteps);
+
+// A compiled colour sequence
+struct Sequence {
+  const char* name;
+  const PackedStep* steps;
+  uint8_t length;
+};
+
+#define SEQUENCE_LENGTH(steps) (sizeof(steps) / sizeof(steps[0]))
+
+// Built-in sequences (index 0 is the default)
+inline constexpr Sequence sequences[] = {
+  {"BASIC", basicPalette.steps, SEQUENCE_LENGTH(basicPaletteSteps)},
+  {"RAINBOW", rainbowSequence.steps, SEQUENCE_LENGTH(rainbowSteps)},
+  {"ALERT", alertSequence.steps, SEQUENCE_LENGTH(alertSteps)}
+};
+inline constexpr int SEQUENCE_COUNT = sizeof(sequences) / sizeof(sequences[0]);
+#define SEQUENCE_NAME_SIZE 12 // longest sequence name kept in a status snapshot, with its terminator
+
+// Define uploaded sequences (sent as one command, e.g. over the network) - kept in RAM only
+#define UPLOAD_MAX_STEPS 32
+#define CUSTOM_COLOUR_NAME "CUSTOM" // shown for colours that aren't a built-in sequence step
+
+// Settings kept across reboots (explicitly padded so the blob compares byte for byte)
+struct Settings {
+  uint8_t version;
+  uint8_t mode;          // State
+  uint8_t sequence;      // index into sequences[]
+  uint8_t step;          // step of that sequence shown on the LED
+  uint8_t brightness;    // LED and backlight level (1-255, perceived brightness)
+  uint8_t rotation;      // ROTATION_PORTRAIT or ROTATION_LANDSCAPE
+  uint16_t autoPeriodMs; // time each colour is shown in auto mode (0 = each step's own period)
+  uint16_t longPressMs;  // long press duration
+};
+
+inline constexpr Settings defaultSettings = {SETTINGS_VERSION, static_cast<uint8_t>(State::Colour_CHANGE_AUTO), 0, 0, 255,
+                                             ROTATION_PORTRAIT, 0, LONG_PRESS_TIME};
+
+// Where the auto colour schedule is - one consistent snapshot for other tasks (see getAutoSchedule())
+struct AutoSchedule {
+  const Sequence* sequence; // the sequence it runs (&uploadedSequence for an uploaded one)
+  uint16_t periodMs;        // settings.autoPeriodMs it was started with
+  int step;                 // step being shown
+  int64_t stepEndUs;        // esp_timer time (us) the step ends
+};
+
+// Define the event bus - button edges, timer ticks and state changes are queued as timestamped events
+// and dispatched in order on the loop task
+#define EVENT_QUEUE_SIZE 32 // number of events that can be queued (must be a power of two)
+
+enum class EventType : uint8_t {
+  BUTTON_EDGE,        // GPIO interrupt - value is the button level after the edge (1 = pressed)
+  AUTO_STEP,          // auto colour timer - value is the scheduler run that made the step due
+  MODE_CHANGED,       // value is the new State
+  COLOUR_CHANGED,     // value is the sequence step now on the LED (-1 = any other colour)
+  BUTTON_CHANGED,     // value is the button state now shown (1 = pressed)
+  ROTATION_CHANGED,   // value is the new screen rotation
+  BRIGHTNESS_CHANGED, // value is the new brightness
+  AUDIO_FRAME,        // audio task - value is the colour of the latest spectrum frame (0xRRGGBB)
+  FLEET_BEACON,       // fleet sync - a beacon from the leader arrived (the loop task reads the latest one)
+  PATTERN_TICK,       // pattern timer - value is the pattern run that made the tick due
+  SET_COLOUR,         // command - value is 0xRRGGBB (switches to manual mode)
+  SET_MODE,           // command - value is the State to switch to
+  SET_PERIOD,         // command - value is the auto period in ms for every step (0 = each step's own period)
+  SET_SEQUENCE,       // command - value is the index of a built-in sequence
+  SET_ROTATION,       // command - value is ROTATION_PORTRAIT or ROTATION_LANDSCAPE
+  SET_BRIGHTNESS,     // command - value is the brightness (BRIGHTNESS_MIN-255)
+  LOAD_SEQUENCE,      // command - install and play the sequence staged with stageSequenceUpload()
+  LOAD_PATTERN,       // command - install and play the pattern staged with stagePattern()
+  LOAD_PATTERN_FILE   // startup - load the pattern stored on LittleFS (posted by setup() for the first loop pass)
+};
+
+struct Event {
+  EventType type;
+  int32_t value;
+  int64_t timeUs; // esp_timer time (us) of the input that caused the event
+};
+
+// Define global variables (owned by the input/LED task - the display task only sees DisplayState snapshots)
+extern int currentStep;
+extern State currentState;
+extern bool buttonPressed;
+extern const Sequence* activeSequence;
+extern Sequence uploadedSequence;
+extern const char* const customColourName;
+extern bool customColour;
+extern RGBColour currentRGB;
+extern Settings settings;
+extern bool settingsDirty;
+extern uint32_t droppedEvents;
+extern int64_t dispatchTimeUs;
+extern TaskHandle_t loopTaskHandle;
+
+// Boot stage timestamps (esp_timer time in us since reset), printed once the display is up
+extern int64_t bootLEDTime;
+extern int64_t bootInputTime;
+
+
+/*************************************************************
+********************** HELPER FUNCTIONS **********************
+**************************************************************/
+
+// Event bus
+void postEventFromISR(EventType type, int32_t value);
+void postEvent(EventType type, int32_t value = 0);
+bool popEvent(Event &event);
+bool eventsPending();
+
+// Settings
+void loadSettings();
+void markSettingsDirty();
+void saveSettings();
+uint32_t serviceSettings();
+
+// Colour sequences and modes
+uint32_t stepDuration(int step);
+void setLEDRGB(uint8_t r, uint8_t g, uint8_t b);
+void applySequenceStep(int step, bool fade = false);
+void changeColour();
+void setupAutoColourTimer();
+void startAutoColour();
+void startAutoColourAt(int step, int64_t stepEndUs);
+void stopAutoColour();
+uint32_t nextAutoStepDelay();
+bool getAutoSchedule(AutoSchedule &schedule);
+void nudgeAutoColour(int32_t advanceUs);
+void useSequence(const Sequence* sequence);
+void selectSequence(int index);
+bool modeAvailable(State mode);
+void setMode(State mode);
+void setBrightness(uint8_t brightness);
+void stepBrightness();
+void handleAutoStep(const Event &event);
+#ifdef ENABLE_AUDIO_MODE
+void handleAudioFrame(const Event &event);
+#endif
+bool stageSequenceUpload(const SequenceStep* steps, int length);
+void installUploadedSequence();
+void handleCommand(const Event &event);
+
+#endif // STATE_H
@@ -0,0 +1,108 @@
+/*************************************************************
+************************* DEFINITIONS ************************
+**************************************************************/
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+// Crash-safe event log, always built in. The last TELEMETRY_SIZE events are kept in a ring buffer in RTC slow
+// memory (RTC_NOINIT_ATTR), which is not cleared by a panic, a watchdog or a software reset and is kept through
+// light sleep, so after a misbehaving board reboots its log still shows what it was doing. Only a power-on
+// (or a log that fails its magic check) starts it afresh.
+//
+// Each record is one 32-bit word - type(8) value(8) time(16):
+//   type   the EventType, or TELEMETRY_BOOT for the record written at boot
+//   value  the low byte of the event's value (the step, mode, level...), or the esp_reset_reason() at boot
+//   time   the event's esp_timer time in ticks of 2^TELEMETRY_TICK_SHIFT us (16.4 ms, wrapping every 17.9 minutes)
+// Events are logged by the loop task as they are dispatched - stamped with the time of the input that caused them,
+// and before they are handled, so after a crash the last record is the event that was being handled. With one
+// writer an append is a load, two stores and no lock (a few dozen cycles), cheap enough to stay on.
+//
+// Send "dump" (and a newline) over serial to print the log, oldest record first.
+
+#include <Arduino.h>
+#include <atomic>
+
+#include "state.h"
+
+// Define the log
+#define TELEMETRY_SIZE 512               // records kept (a power of two - 2 KB of RTC slow memory)
+#define TELEMETRY_MAGIC 0x544C4D31       // "TLM1" (change it when the record layout changes)
+#define TELEMETRY_TICK_SHIFT 14          // time field in units of 2^14 us
+#define TELEMETRY_BOOT 0xFF              // type of the record written at boot (its value is the reset reason)
+
+// Define the serial console
+#define TELEMETRY_CONSOLE_POLL 100       // ms between serial input checks
+#define TELEMETRY_CONSOLE_CORE 0         // with the display task - away from input and LED control
+#define TELEMETRY_CONSOLE_PRIORITY 1
+#define TELEMETRY_CONSOLE_STACK_SIZE 3072
+
+static_assert((TELEMETRY_SIZE & (TELEMETRY_SIZE - 1)) == 0, "TELEMETRY_SIZE must be a power of two");
+
+// The ring buffer (in RTC slow memory on the board)
+struct TelemetryLog {
+  uint32_t magic;
+  volatile uint32_t head; // records ever appended (wraps) - the next one goes to records[head % TELEMETRY_SIZE]
+  uint32_t records[TELEMETRY_SIZE];
+};
+
+extern TelemetryLog telemetryLog;
+
+// EventTypes that are logged - the high-rate ones (timer ticks, audio frames, fleet beacons) and the screen-only
+// button change would push everything else out of the log, and their effect is logged anyway (as COLOUR_CHANGED).
+// One bit per EventType, so there must stay fewer than 32 of them
+#define TELEMETRY_EVENT_BIT(type) (1UL << static_cast<uint8_t>(EventType::type))
+#define TELEMETRY_EVENT_MASK (~(TELEMETRY_EVENT_BIT(AUTO_STEP) | TELEMETRY_EVENT_BIT(AUDIO_FRAME) | \
+                                TELEMETRY_EVENT_BIT(FLEET_BEACON) | TELEMETRY_EVENT_BIT(PATTERN_TICK) | \
+                                TELEMETRY_EVENT_BIT(BUTTON_CHANGED)))
+
+
+/*************************************************************
+********************** HELPER FUNCTIONS **********************
+**************************************************************/
+
+// Function to append one record (loop task only - the single writer)
+inline void logTelemetry(uint8_t type, uint8_t value, int64_t timeUs) {
+  uint32_t head = telemetryLog.head;
+  telemetryLog.records[head & (TELEMETRY_SIZE - 1)] = (static_cast<uint32_t>(type) << 24) |
+                                                      (static_cast<uint32_t>(value) << 16) |
+                                                      (static_cast<uint32_t>(timeUs >> TELEMETRY_TICK_SHIFT) & 0xFFFF);
+  std::atomic_signal_fence(std::memory_order_release); // the record is in place before the head covers it
+  telemetryLog.head = head + 1;
+}
+
+// Function to log a dispatched event, if its type is logged
+inline void logTelemetryEvent(const Event &event) {
+  if ((TELEMETRY_EVENT_MASK >> static_cast<uint8_t>(event.type)) & 1) {
+    logTelemetry(static_cast<uint8_t>(event.type), static_cast<uint8_t>(event.value), event.timeUs);
+  }
+}
+
+// Functions to take a record apart
+inline uint8_t telemetryType(uint32_t record) {
+  return record >> 24;
+}
+
+inline uint8_t telemetryValue(uint32_t record) {
+  return (record >> 16) & 0xFF;
+}
+
+inline uint32_t telemetryTimeMs(uint32_t record) {
+  return static_cast<uint32_t>((static_cast<uint64_t>(record & 0xFFFF) << TELEMETRY_TICK_SHIFT) / 1000);
+}
+
+// Function to check the log kept from before the reset (starting afresh after a power-on), log the boot and start
+// the serial console (call first thing in setup())
+void startTelemetry();
+
+// Function to get how many records the log holds, and one of them (0 = the oldest)
+uint32_t telemetryCount();
+uint32_t telemetryRecord(uint32_t index);
+
+// Function to print the log over serial, oldest record first
+void dumpTelemetry();
+
+// Function to get a readable name for a reset reason
+const char* resetReasonName(int reason);
+
+#endif // TELEMETRY_H
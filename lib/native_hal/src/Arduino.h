@@ -0,0 +1,70 @@
+// Arduino core mock for the native build (see native_hal.h) - time comes from the virtual clock
+
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+#include <algorithm>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_NOINIT_ATTR
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+using std::max;
+using std::min;
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define digitalPinToInterrupt(pin) (pin)
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode);
+void detachInterrupt(uint8_t pin);
+
+uint32_t getCpuFrequencyMhz();
+void* ps_malloc(size_t size);
+
+// Serial output goes to stdout (and there is never any input)
+class HardwareSerial {
+public:
+  void begin(unsigned long baud);
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+  size_t print(const char* text);
+  size_t print(int value);
+  size_t println(const char* text = "");
+  size_t println(int value);
+  int available();
+  int read();
+  operator bool() const {
+    return true;
+  }
+};
+
+extern HardwareSerial Serial;
+
+#endif // NATIVE_ARDUINO_H
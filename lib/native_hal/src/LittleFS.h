@@ -0,0 +1,39 @@
+// LittleFS mock for the native build (see native_hal.h) - files live in memory until halReset()
+
+#ifndef NATIVE_LITTLEFS_H
+#define NATIVE_LITTLEFS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// A file opened for reading
+class File {
+public:
+  File() = default;
+  explicit File(const std::vector<uint8_t>* data) : data(data) {}
+
+  explicit operator bool() const {
+    return data != nullptr;
+  }
+  size_t size() const;
+  size_t read(uint8_t* buffer, size_t length);
+  void close();
+
+private:
+  const std::vector<uint8_t>* data = nullptr;
+  size_t position = 0;
+};
+
+class LittleFSFS {
+public:
+  bool begin(bool formatOnFail = false);
+  bool exists(const char* path);
+  File open(const char* path, const char* mode = "r");
+};
+
+extern LittleFSFS LittleFS;
+
+#endif // NATIVE_LITTLEFS_H
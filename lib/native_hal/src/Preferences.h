@@ -0,0 +1,24 @@
+// Preferences (NVS) mock for the native build (see native_hal.h) - values live in memory until halReset()
+
+#ifndef NATIVE_PREFERENCES_H
+#define NATIVE_PREFERENCES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Preferences {
+public:
+  bool begin(const char* name, bool readOnly = false);
+  void end();
+  bool clear();
+  bool remove(const char* key);
+  size_t putBytes(const char* key, const void* value, size_t length);
+  size_t getBytes(const char* key, void* buffer, size_t length);
+  size_t getBytesLength(const char* key);
+  bool isKey(const char* key);
+
+private:
+  char name[16] = "";
+};
+
+#endif // NATIVE_PREFERENCES_H
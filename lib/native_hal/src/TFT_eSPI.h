@@ -0,0 +1,111 @@
+// TFT_eSPI mock for the native build (see native_hal.h) - nothing is rasterised; every call that would reach the
+// panel is counted in halDisplayStats(), and sprites only count when they are pushed
+
+#ifndef NATIVE_TFT_ESPI_H
+#define NATIVE_TFT_ESPI_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef TFT_WIDTH
+#define TFT_WIDTH 170
+#endif
+#ifndef TFT_HEIGHT
+#define TFT_HEIGHT 320
+#endif
+
+#define TFT_BLACK 0x0000
+#define TFT_BLUE 0x001F
+#define TFT_RED 0xF800
+#define TFT_GREEN 0x07E0
+#define TFT_CYAN 0x07FF
+#define TFT_MAGENTA 0xF81F
+#define TFT_YELLOW 0xFFE0
+#define TFT_WHITE 0xFFFF
+
+#define PSRAM_ENABLE 3 // sprite attribute
+
+class TFT_eSPI {
+public:
+  TFT_eSPI(int16_t width = TFT_WIDTH, int16_t height = TFT_HEIGHT);
+  virtual ~TFT_eSPI() = default;
+
+  void init();
+  void setRotation(uint8_t rotation);
+  int16_t width() const {
+    return viewWidth;
+  }
+  int16_t height() const {
+    return viewHeight;
+  }
+
+  void startWrite() {}
+  void endWrite() {}
+  void writecommand(uint8_t command);
+  void writedata(uint8_t data);
+
+  void setTextFont(uint8_t font) {
+    textFont = font;
+  }
+  void setTextColor(uint16_t foreground, uint16_t background);
+  void setCursor(int16_t x, int16_t y);
+  size_t print(const char* text);
+  size_t println(const char* text = "");
+  int16_t textWidth(const char* text, uint8_t font) const;
+  int16_t fontHeight(uint8_t font) const;
+
+  virtual void fillScreen(uint32_t colour);
+  virtual void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t colour);
+  virtual int16_t drawString(const char* text, int32_t x, int32_t y, uint8_t font);
+  virtual int16_t drawString(const char* text, int32_t x, int32_t y);
+  virtual void pushImage(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t* data);
+
+  uint16_t color565(uint8_t r, uint8_t g, uint8_t b) const {
+    return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+  }
+
+protected:
+  // Function to count one operation and the pixels it writes, if it reaches the panel
+  void countText(const char* text, uint8_t font);
+
+  bool onPanel = true;  // false for sprites - their drawing stays in RAM
+  int16_t panelWidth;
+  int16_t panelHeight;
+  int16_t viewWidth;
+  int16_t viewHeight;
+  uint8_t textFont = 1;
+  int16_t cursorX = 0;
+  int16_t cursorY = 0;
+};
+
+class TFT_eSprite : public TFT_eSPI {
+public:
+  explicit TFT_eSprite(TFT_eSPI* tft);
+  ~TFT_eSprite() override;
+
+  void setColorDepth(int8_t depth) {
+    (void)depth;
+  }
+  void setAttribute(uint8_t attribute, uint8_t value) {
+    (void)attribute;
+    (void)value;
+  }
+  void* createSprite(int16_t width, int16_t height);
+  void deleteSprite();
+  void* getPointer() const {
+    return pixels;
+  }
+
+  void fillSprite(uint32_t colour);
+  void pushSprite(int32_t x, int32_t y);
+
+  // Drawing into a sprite writes its own buffer, not the panel
+  void fillScreen(uint32_t colour) override;
+  void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t colour) override;
+  void pushImage(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t* data) override;
+
+private:
+  uint16_t* pixels = nullptr;
+};
+
+#endif // NATIVE_TFT_ESPI_H
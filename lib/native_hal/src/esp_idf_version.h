@@ -0,0 +1,12 @@
+// ESP-IDF version mock for the native build (see native_hal.h) - the firmware takes its IDF 4.4 paths
+
+#ifndef NATIVE_ESP_IDF_VERSION_H
+#define NATIVE_ESP_IDF_VERSION_H
+
+#define ESP_IDF_VERSION_VAL(major, minor, patch) (((major) << 16) | ((minor) << 8) | (patch))
+#define ESP_IDF_VERSION_MAJOR 4
+#define ESP_IDF_VERSION_MINOR 4
+#define ESP_IDF_VERSION_PATCH 0
+#define ESP_IDF_VERSION ESP_IDF_VERSION_VAL(ESP_IDF_VERSION_MAJOR, ESP_IDF_VERSION_MINOR, ESP_IDF_VERSION_PATCH)
+
+#endif // NATIVE_ESP_IDF_VERSION_H
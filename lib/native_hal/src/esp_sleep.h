@@ -0,0 +1,33 @@
+// Sleep mock for the native build (see native_hal.h) - light sleep moves the virtual clock to the wake-up
+
+#ifndef NATIVE_ESP_SLEEP_H
+#define NATIVE_ESP_SLEEP_H
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef enum {
+  ESP_PD_DOMAIN_RTC8M,
+  ESP_PD_DOMAIN_RC_FAST
+} esp_sleep_pd_domain_t;
+
+typedef enum {
+  ESP_PD_OPTION_OFF,
+  ESP_PD_OPTION_ON,
+  ESP_PD_OPTION_AUTO
+} esp_sleep_pd_option_t;
+
+typedef enum {
+  ESP_SLEEP_WAKEUP_ALL,
+  ESP_SLEEP_WAKEUP_TIMER,
+  ESP_SLEEP_WAKEUP_GPIO
+} esp_sleep_source_t;
+
+esp_err_t esp_sleep_pd_config(esp_sleep_pd_domain_t domain, esp_sleep_pd_option_t option);
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t timeUs);
+esp_err_t esp_sleep_enable_gpio_wakeup();
+esp_err_t esp_sleep_disable_wakeup_source(esp_sleep_source_t source);
+esp_err_t esp_light_sleep_start();
+
+#endif // NATIVE_ESP_SLEEP_H
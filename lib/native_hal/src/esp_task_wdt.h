@@ -0,0 +1,16 @@
+// Task watchdog mock for the native build (see native_hal.h) - tasks are not run, so nothing is ever starved
+
+#ifndef NATIVE_ESP_TASK_WDT_H
+#define NATIVE_ESP_TASK_WDT_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "esp_err.h"
+
+esp_err_t esp_task_wdt_init(uint32_t timeoutSeconds, bool panic);
+esp_err_t esp_task_wdt_add(TaskHandle_t task);
+esp_err_t esp_task_wdt_reset();
+esp_err_t esp_task_wdt_delete(TaskHandle_t task);
+
+#endif // NATIVE_ESP_TASK_WDT_H
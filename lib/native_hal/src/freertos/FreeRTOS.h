@@ -0,0 +1,45 @@
+// FreeRTOS mock for the native build (see native_hal.h) - one thread, so critical sections are no-ops and a
+// tick is 1 ms of virtual time
+
+#ifndef NATIVE_FREERTOS_H
+#define NATIVE_FREERTOS_H
+
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define portMAX_DELAY 0xFFFFFFFFUL
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) (static_cast<TickType_t>(ms))
+
+#define portYIELD_FROM_ISR() do {} while (0)
+
+typedef struct {
+  uint32_t owner;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0}
+
+inline void portENTER_CRITICAL(portMUX_TYPE* mux) {
+  (void)mux;
+}
+
+inline void portEXIT_CRITICAL(portMUX_TYPE* mux) {
+  (void)mux;
+}
+
+inline void portENTER_CRITICAL_ISR(portMUX_TYPE* mux) {
+  (void)mux;
+}
+
+inline void portEXIT_CRITICAL_ISR(portMUX_TYPE* mux) {
+  (void)mux;
+}
+
+#endif // NATIVE_FREERTOS_H
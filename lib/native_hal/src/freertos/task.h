@@ -0,0 +1,25 @@
+// FreeRTOS task mock for the native build (see native_hal.h) - tasks are created but never run (the test calls
+// their work directly); the calling code is the loop task unless a timer callback or interrupt is running
+
+#ifndef NATIVE_FREERTOS_TASK_H
+#define NATIVE_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+typedef struct tskTaskControlBlock* TaskHandle_t;
+typedef void (*TaskFunction_t)(void* parameter);
+
+TaskHandle_t xTaskGetCurrentTaskHandle();
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char* name, uint32_t stackSize, void* parameter,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount();
+BaseType_t xPortGetCoreID();
+
+// Notifications to the loop task end its blocking wait (ulTaskNotifyTake moves the clock until one arrives)
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken);
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks);
+
+#endif // NATIVE_FREERTOS_TASK_H
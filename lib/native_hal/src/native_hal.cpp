@@ -0,0 +1,1048 @@
+// Host implementation of the mocked board (see native_hal.h)
+
+#include <stdarg.h>
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <Preferences.h>
+#include <TFT_eSPI.h>
+#include <driver/gpio.h>
+#include <driver/ledc.h>
+#include <esp_sleep.h>
+#include <esp_system.h>
+#include <esp_task_wdt.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <soc/gpio_reg.h>
+
+#include "native_hal.h"
+
+#define HAL_PIN_COUNT 49     // GPIO0-48 on the ESP32-S3
+#define HAL_CPU_FREQ_MHZ 240
+
+struct esp_timer {
+  esp_timer_cb_t callback;
+  void* arg;
+  const char* name;
+  bool active;
+  int64_t deadline; // virtual time (us) of the next expiry
+  uint64_t period;  // 0 for one-shot timers
+};
+
+struct QueueDefinition {
+  UBaseType_t length;
+  UBaseType_t itemSize;
+  std::deque<std::vector<uint8_t>> items;
+};
+
+namespace {
+
+// A pin change scheduled by a test
+struct PinChange {
+  int pin;
+  int level;
+  int64_t timeUs;
+};
+
+// The calling context - the loop task unless a timer callback or an interrupt handler is running
+TaskHandle_t const loopTask = reinterpret_cast<TaskHandle_t>(1);
+TaskHandle_t const timerTask = reinterpret_cast<TaskHandle_t>(2);
+TaskHandle_t const interruptContext = reinterpret_cast<TaskHandle_t>(3);
+uintptr_t nextTaskHandle = 16;
+TaskHandle_t currentTask = loopTask;
+
+// Clock
+int64_t nowUs = 0;
+int64_t horizonUs = INT64_MAX;
+std::vector<esp_timer*> timers;
+std::vector<PinChange> pinChanges; // kept in time order
+
+// GPIO
+int pinLevels[HAL_PIN_COUNT];
+void (*pinHandlers[HAL_PIN_COUNT])(void);
+int pinInterruptModes[HAL_PIN_COUNT];
+bool pinInterruptEnabled[HAL_PIN_COUNT];
+int pinWakeLevels[HAL_PIN_COUNT]; // level that wakes the chip from light sleep (-1 = not a wake source)
+
+// Sleep and notifications
+bool timerWakeupEnabled = false;
+uint64_t timerWakeupUs = 0;
+bool gpioWakeupEnabled = false;
+uint32_t sleepCount = 0;
+int64_t sleepTimeUs = 0;
+uint32_t notifications = 0; // pending notifications for the loop task
+
+// Peripherals
+uint32_t ledcPending[LEDC_CHANNEL_MAX];
+uint32_t ledcDuty[LEDC_CHANNEL_MAX];
+uint32_t ledcUpdates[LEDC_CHANNEL_MAX];
+DisplayStats displayStats = {};
+int64_t panelDelayUs = 0; // time each panel operation takes
+std::map<std::string, std::vector<uint8_t>> nvs;
+uint32_t nvsWrites = 0;
+std::map<std::string, std::vector<uint8_t>> files; // the LittleFS partition
+std::vector<QueueDefinition*> queues;
+esp_reset_reason_t resetReason = ESP_RST_POWERON;
+
+// Function to check that a pin number is in range
+bool validPin(int pin) {
+  return pin >= 0 && pin < HAL_PIN_COUNT;
+}
+
+// Function to set a pin level and run its interrupt handler if the edge matches
+void applyPinLevel(int pin, int level) {
+  if (!validPin(pin)) {
+    return;
+  }
+  int previous = pinLevels[pin];
+  pinLevels[pin] = level ? HIGH : LOW;
+  if (previous == pinLevels[pin] || pinHandlers[pin] == nullptr || !pinInterruptEnabled[pin]) {
+    return;
+  }
+
+  int mode = pinInterruptModes[pin];
+  bool rising = (pinLevels[pin] == HIGH);
+  if (mode == CHANGE || (mode == RISING && rising) || (mode == FALLING && !rising)) {
+    TaskHandle_t interrupted = currentTask;
+    currentTask = interruptContext;
+    pinHandlers[pin]();
+    currentTask = interrupted;
+  }
+}
+
+// Function to fire one timer whose deadline has been reached
+void fireTimer(esp_timer* timer) {
+  if (timer->period > 0) {
+    timer->deadline += timer->period;
+  } else {
+    timer->active = false;
+  }
+
+  TaskHandle_t caller = currentTask;
+  currentTask = timerTask;
+  timer->callback(timer->arg);
+  currentTask = caller;
+}
+
+// Function to find the active timer with the earliest deadline (nullptr if none are running)
+esp_timer* nextTimer() {
+  esp_timer* earliest = nullptr;
+  for (esp_timer* timer : timers) {
+    if (timer->active && (earliest == nullptr || timer->deadline < earliest->deadline)) {
+      earliest = timer;
+    }
+  }
+  return earliest;
+}
+
+// Function to move the clock towards targetUs, firing timers (if fireTimers) and pin changes in time order -
+// stops early, at the time of the event, as soon as wake() is true
+template <typename WakeCondition>
+void advanceTo(int64_t targetUs, bool fireTimers, WakeCondition wake) {
+  for (;;) {
+    if (wake()) {
+      return;
+    }
+
+    esp_timer* timer = fireTimers ? nextTimer() : nullptr;
+    const PinChange* change = pinChanges.empty() ? nullptr : &pinChanges.front();
+    int64_t timerTime = timer ? std::max(timer->deadline, nowUs) : INT64_MAX;
+    int64_t changeTime = change ? std::max(change->timeUs, nowUs) : INT64_MAX;
+    int64_t eventTime = std::min(timerTime, changeTime);
+
+    if (eventTime > targetUs || eventTime == INT64_MAX) {
+      if (targetUs != INT64_MAX && targetUs > nowUs) {
+        nowUs = targetUs;
+      }
+      return;
+    }
+
+    nowUs = eventTime;
+    if (changeTime <= timerTime) { // pin changes first, like an interrupt preempting the timer task
+      PinChange next = *change;
+      pinChanges.erase(pinChanges.begin());
+      applyPinLevel(next.pin, next.level);
+    } else {
+      fireTimer(timer);
+    }
+  }
+}
+
+// Function to check if a light sleep wake-up pin is at its wake level
+bool wakePinActive() {
+  if (!gpioWakeupEnabled) {
+    return false;
+  }
+  for (int pin = 0; pin < HAL_PIN_COUNT; pin++) {
+    if (pinWakeLevels[pin] >= 0 && pinLevels[pin] == pinWakeLevels[pin]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Function to convert a FreeRTOS timeout to an absolute virtual time, limited by the horizon
+int64_t timeoutToUs(TickType_t ticks) {
+  int64_t target = (ticks == portMAX_DELAY) ? INT64_MAX : nowUs + static_cast<int64_t>(ticks) * 1000;
+  return std::min(target, horizonUs);
+}
+
+// Function to spend the time a panel operation takes (see halSetPanelDelayUs())
+void panelBusy() {
+  if (panelDelayUs > 0) {
+    halAdvanceUs(panelDelayUs);
+  }
+}
+
+} // namespace
+
+/*************************************************************
+************************* NATIVE HAL *************************
+**************************************************************/
+
+void halReset() {
+  for (esp_timer* timer : timers) {
+    delete timer;
+  }
+  timers.clear();
+  for (QueueDefinition* queue : queues) {
+    delete queue;
+  }
+  queues.clear();
+  pinChanges.clear();
+
+  nowUs = 0;
+  horizonUs = INT64_MAX;
+  currentTask = loopTask;
+  notifications = 0;
+  for (int pin = 0; pin < HAL_PIN_COUNT; pin++) {
+    pinLevels[pin] = HIGH; // inputs idle high (the button is active low with a pull-up)
+    pinHandlers[pin] = nullptr;
+    pinInterruptModes[pin] = CHANGE;
+    pinInterruptEnabled[pin] = false;
+    pinWakeLevels[pin] = -1;
+  }
+
+  timerWakeupEnabled = false;
+  gpioWakeupEnabled = false;
+  sleepCount = 0;
+  sleepTimeUs = 0;
+  for (int channel = 0; channel < LEDC_CHANNEL_MAX; channel++) {
+    ledcPending[channel] = 0;
+    ledcDuty[channel] = 0;
+    ledcUpdates[channel] = 0;
+  }
+  displayStats = {};
+  panelDelayUs = 0;
+  nvs.clear();
+  nvsWrites = 0;
+  resetReason = ESP_RST_POWERON;
+}
+
+int64_t halNowUs() {
+  return nowUs;
+}
+
+void halAdvanceUs(int64_t us) {
+  advanceTo(nowUs + us, true, [] { return false; });
+}
+
+void halSetHorizonUs(int64_t timeUs) {
+  horizonUs = timeUs;
+}
+
+void halSetPin(int pin, int level) {
+  applyPinLevel(pin, level);
+}
+
+void halSchedulePin(int pin, int level, int64_t timeUs) {
+  PinChange change = {pin, level, timeUs};
+  auto position = std::upper_bound(pinChanges.begin(), pinChanges.end(), change,
+                                   [](const PinChange &a, const PinChange &b) { return a.timeUs < b.timeUs; });
+  pinChanges.insert(position, change);
+}
+
+int halPinLevel(int pin) {
+  return validPin(pin) ? pinLevels[pin] : LOW;
+}
+
+uint32_t halSleepCount() {
+  return sleepCount;
+}
+
+int64_t halSleepTimeUs() {
+  return sleepTimeUs;
+}
+
+uint32_t halLedcDuty(int channel) {
+  return (channel >= 0 && channel < LEDC_CHANNEL_MAX) ? ledcDuty[channel] : 0;
+}
+
+uint32_t halLedcUpdates(int channel) {
+  return (channel >= 0 && channel < LEDC_CHANNEL_MAX) ? ledcUpdates[channel] : 0;
+}
+
+const DisplayStats &halDisplayStats() {
+  return displayStats;
+}
+
+void halResetDisplayStats() {
+  displayStats = {};
+}
+
+void halSetPanelDelayUs(int64_t us) {
+  panelDelayUs = us;
+}
+
+uint32_t halNvsWrites() {
+  return nvsWrites;
+}
+
+void halWriteFile(const char* path, const void* data, size_t length) {
+  if (data == nullptr) {
+    files.erase(path);
+    return;
+  }
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  files[path].assign(bytes, bytes + length);
+}
+
+void halSetResetReason(int reason) {
+  resetReason = static_cast<esp_reset_reason_t>(reason);
+}
+
+/*************************************************************
+*********************** ARDUINO CORE *************************
+**************************************************************/
+
+HardwareSerial Serial;
+
+unsigned long millis() {
+  return static_cast<unsigned long>(nowUs / 1000);
+}
+
+unsigned long micros() {
+  return static_cast<unsigned long>(nowUs);
+}
+
+void delay(uint32_t ms) {
+  halAdvanceUs(static_cast<int64_t>(ms) * 1000);
+}
+
+void delayMicroseconds(uint32_t us) {
+  halAdvanceUs(us);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (validPin(pin) && mode == INPUT_PULLUP) {
+    pinLevels[pin] = HIGH;
+  }
+}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+  applyPinLevel(pin, level);
+}
+
+int digitalRead(uint8_t pin) {
+  return halPinLevel(pin);
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode) {
+  if (validPin(pin)) {
+    pinHandlers[pin] = handler;
+    pinInterruptModes[pin] = mode;
+    pinInterruptEnabled[pin] = true;
+  }
+}
+
+void detachInterrupt(uint8_t pin) {
+  if (validPin(pin)) {
+    pinHandlers[pin] = nullptr;
+    pinInterruptEnabled[pin] = false;
+  }
+}
+
+uint32_t getCpuFrequencyMhz() {
+  return HAL_CPU_FREQ_MHZ;
+}
+
+void* ps_malloc(size_t size) {
+  return malloc(size);
+}
+
+void HardwareSerial::begin(unsigned long baud) {
+  (void)baud;
+}
+
+size_t HardwareSerial::printf(const char* format, ...) {
+  va_list arguments;
+  va_start(arguments, format);
+  int length = vprintf(format, arguments);
+  va_end(arguments);
+  return length > 0 ? length : 0;
+}
+
+size_t HardwareSerial::print(const char* text) {
+  return fputs(text, stdout) >= 0 ? strlen(text) : 0;
+}
+
+size_t HardwareSerial::print(int value) {
+  return printf("%d", value);
+}
+
+size_t HardwareSerial::println(const char* text) {
+  return printf("%s\n", text);
+}
+
+size_t HardwareSerial::println(int value) {
+  return printf("%d\n", value);
+}
+
+int HardwareSerial::available() {
+  return 0; // nothing is ever typed in
+}
+
+int HardwareSerial::read() {
+  return -1;
+}
+
+void halWriteRegister(uint32_t reg, uint32_t value) {
+  if (reg != GPIO_OUT_W1TS_REG && reg != GPIO_OUT_W1TC_REG) {
+    return;
+  }
+  for (int pin = 0; pin < 32; pin++) {
+    if (value & (1UL << pin)) {
+      applyPinLevel(pin, reg == GPIO_OUT_W1TS_REG ? HIGH : LOW);
+    }
+  }
+}
+
+/*************************************************************
+************************** ESP-IDF ***************************
+**************************************************************/
+
+esp_err_t esp_task_wdt_init(uint32_t timeoutSeconds, bool panic) {
+  (void)timeoutSeconds;
+  (void)panic;
+  return ESP_OK;
+}
+
+esp_err_t esp_task_wdt_add(TaskHandle_t task) {
+  (void)task;
+  return ESP_OK;
+}
+
+esp_err_t esp_task_wdt_reset() {
+  return ESP_OK;
+}
+
+esp_err_t esp_task_wdt_delete(TaskHandle_t task) {
+  (void)task;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle) {
+  if (args == nullptr || args->callback == nullptr || handle == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  esp_timer* timer = new esp_timer{args->callback, args->arg, args->name, false, 0, 0};
+  timers.push_back(timer);
+  *handle = timer;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeoutUs) {
+  if (timer == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (timer->active) {
+    return ESP_ERR_INVALID_STATE; // same as the real driver - a running timer must be stopped first
+  }
+  timer->active = true;
+  timer->deadline = nowUs + static_cast<int64_t>(timeoutUs);
+  timer->period = 0;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t periodUs) {
+  if (timer == nullptr || periodUs == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (timer->active) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->active = true;
+  timer->deadline = nowUs + static_cast<int64_t>(periodUs);
+  timer->period = periodUs;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+  if (timer == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (!timer->active) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->active = false;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+  auto position = std::find(timers.begin(), timers.end(), timer);
+  if (position == timers.end()) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  timers.erase(position);
+  delete timer;
+  return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) {
+  return timer != nullptr && timer->active;
+}
+
+int64_t esp_timer_get_time() {
+  return nowUs;
+}
+
+esp_reset_reason_t esp_reset_reason() {
+  return resetReason;
+}
+
+esp_err_t esp_sleep_pd_config(esp_sleep_pd_domain_t domain, esp_sleep_pd_option_t option) {
+  (void)domain;
+  (void)option;
+  return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t timeUs) {
+  timerWakeupEnabled = true;
+  timerWakeupUs = timeUs;
+  return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_gpio_wakeup() {
+  gpioWakeupEnabled = true;
+  return ESP_OK;
+}
+
+esp_err_t esp_sleep_disable_wakeup_source(esp_sleep_source_t source) {
+  if (source == ESP_SLEEP_WAKEUP_ALL || source == ESP_SLEEP_WAKEUP_TIMER) {
+    timerWakeupEnabled = false;
+  }
+  if (source == ESP_SLEEP_WAKEUP_ALL || source == ESP_SLEEP_WAKEUP_GPIO) {
+    gpioWakeupEnabled = false;
+  }
+  return ESP_OK;
+}
+
+// Timers don't run while the chip sleeps - only pin changes are processed until a wake-up source triggers
+esp_err_t esp_light_sleep_start() {
+  sleepCount++;
+  int64_t start = nowUs;
+  int64_t target = timerWakeupEnabled ? nowUs + static_cast<int64_t>(timerWakeupUs) : INT64_MAX;
+  advanceTo(std::min(target, horizonUs), false, wakePinActive);
+  sleepTimeUs += nowUs - start;
+  return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t pin, gpio_mode_t mode) {
+  (void)pin;
+  (void)mode;
+  return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t pin, uint32_t level) {
+  applyPinLevel(pin, level);
+  return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t pin) {
+  return halPinLevel(pin);
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t pin, gpio_int_type_t type) {
+  if (!validPin(pin)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  pinInterruptModes[pin] = (type == GPIO_INTR_POSEDGE) ? RISING : (type == GPIO_INTR_NEGEDGE) ? FALLING : CHANGE;
+  return ESP_OK;
+}
+
+esp_err_t gpio_intr_enable(gpio_num_t pin) {
+  if (!validPin(pin)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  pinInterruptEnabled[pin] = true;
+  return ESP_OK;
+}
+
+esp_err_t gpio_intr_disable(gpio_num_t pin) {
+  if (!validPin(pin)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  pinInterruptEnabled[pin] = false;
+  return ESP_OK;
+}
+
+esp_err_t gpio_wakeup_enable(gpio_num_t pin, gpio_int_type_t type) {
+  if (!validPin(pin) || (type != GPIO_INTR_LOW_LEVEL && type != GPIO_INTR_HIGH_LEVEL)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  pinWakeLevels[pin] = (type == GPIO_INTR_HIGH_LEVEL) ? HIGH : LOW;
+  return ESP_OK;
+}
+
+esp_err_t gpio_wakeup_disable(gpio_num_t pin) {
+  if (!validPin(pin)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  pinWakeLevels[pin] = -1;
+  return ESP_OK;
+}
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t* config) {
+  return config ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t ledc_channel_config(const ledc_channel_config_t* config) {
+  if (config == nullptr || config->channel >= LEDC_CHANNEL_MAX) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  ledcPending[config->channel] = config->duty;
+  ledcDuty[config->channel] = config->duty;
+  return ESP_OK;
+}
+
+esp_err_t ledc_set_duty(ledc_mode_t mode, ledc_channel_t channel, uint32_t duty) {
+  (void)mode;
+  if (channel >= LEDC_CHANNEL_MAX) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  ledcPending[channel] = duty;
+  return ESP_OK;
+}
+
+esp_err_t ledc_update_duty(ledc_mode_t mode, ledc_channel_t channel) {
+  (void)mode;
+  if (channel >= LEDC_CHANNEL_MAX) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  ledcDuty[channel] = ledcPending[channel];
+  ledcUpdates[channel]++;
+  return ESP_OK;
+}
+
+uint32_t ledc_get_duty(ledc_mode_t mode, ledc_channel_t channel) {
+  (void)mode;
+  return halLedcDuty(channel);
+}
+
+/*************************************************************
+************************** FREERTOS **************************
+**************************************************************/
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return currentTask;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char* name, uint32_t stackSize, void* parameter,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core) {
+  (void)task;
+  (void)name;
+  (void)stackSize;
+  (void)parameter;
+  (void)priority;
+  (void)core;
+  if (handle != nullptr) {
+    *handle = reinterpret_cast<TaskHandle_t>(nextTaskHandle);
+  }
+  nextTaskHandle++;
+  return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  (void)task;
+}
+
+void vTaskDelay(TickType_t ticks) {
+  halAdvanceUs(static_cast<int64_t>(ticks) * 1000);
+}
+
+TickType_t xTaskGetTickCount() {
+  return static_cast<TickType_t>(nowUs / 1000);
+}
+
+BaseType_t xPortGetCoreID() {
+  return 1; // ARDUINO_RUNNING_CORE
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  (void)task; // only the loop task ever waits for notifications
+  notifications++;
+  return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken) {
+  xTaskNotifyGive(task);
+  if (higherPriorityTaskWoken != nullptr) {
+    *higherPriorityTaskWoken = pdTRUE;
+  }
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+  if (notifications == 0 && ticks > 0) {
+    advanceTo(timeoutToUs(ticks), true, [] { return notifications > 0; });
+  }
+
+  uint32_t count = notifications;
+  if (count > 0) {
+    notifications = clearOnExit ? 0 : count - 1;
+  }
+  return count;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  QueueDefinition* queue = new QueueDefinition{length, itemSize, {}};
+  queues.push_back(queue);
+  return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks) {
+  (void)ticks;
+  if (queue->items.size() >= queue->length) {
+    return pdFAIL;
+  }
+  const uint8_t* bytes = static_cast<const uint8_t*>(item);
+  queue->items.emplace_back(bytes, bytes + queue->itemSize);
+  return pdPASS;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void* item, BaseType_t* higherPriorityTaskWoken) {
+  if (higherPriorityTaskWoken != nullptr) {
+    *higherPriorityTaskWoken = pdFALSE;
+  }
+  return xQueueSend(queue, item, 0);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void* item) {
+  queue->items.clear();
+  return xQueueSend(queue, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks) {
+  if (xQueuePeek(queue, item, ticks) != pdPASS) {
+    return pdFAIL;
+  }
+  queue->items.pop_front();
+  return pdPASS;
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void* item, TickType_t ticks) {
+  (void)ticks;
+  if (queue->items.empty()) {
+    return pdFAIL;
+  }
+  memcpy(item, queue->items.front().data(), queue->itemSize);
+  return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  return static_cast<UBaseType_t>(queue->items.size());
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+  return xQueueCreate(1, 0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+  (void)semaphore;
+  (void)ticks;
+  return pdPASS;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  (void)semaphore;
+  return pdPASS;
+}
+
+/*************************************************************
+************************ PREFERENCES *************************
+**************************************************************/
+
+// Function to build the store key for a value in a namespace
+static std::string nvsKey(const char* name, const char* key) {
+  return std::string(name) + "/" + key;
+}
+
+bool Preferences::begin(const char* name, bool readOnly) {
+  (void)readOnly;
+  snprintf(this->name, sizeof(this->name), "%s", name);
+  return true;
+}
+
+void Preferences::end() {}
+
+bool Preferences::clear() {
+  std::string prefix = std::string(name) + "/";
+  for (auto entry = nvs.begin(); entry != nvs.end();) {
+    entry = (entry->first.compare(0, prefix.size(), prefix) == 0) ? nvs.erase(entry) : std::next(entry);
+  }
+  return true;
+}
+
+bool Preferences::remove(const char* key) {
+  return nvs.erase(nvsKey(name, key)) > 0;
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t length) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(value);
+  nvs[nvsKey(name, key)].assign(bytes, bytes + length);
+  nvsWrites++;
+  return length;
+}
+
+size_t Preferences::getBytes(const char* key, void* buffer, size_t length) {
+  auto entry = nvs.find(nvsKey(name, key));
+  if (entry == nvs.end() || entry->second.size() > length) {
+    return 0;
+  }
+  memcpy(buffer, entry->second.data(), entry->second.size());
+  return entry->second.size();
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+  auto entry = nvs.find(nvsKey(name, key));
+  return entry == nvs.end() ? 0 : entry->second.size();
+}
+
+bool Preferences::isKey(const char* key) {
+  return nvs.count(nvsKey(name, key)) > 0;
+}
+
+/*************************************************************
+************************** LITTLEFS **************************
+**************************************************************/
+
+LittleFSFS LittleFS;
+
+size_t File::size() const {
+  return data ? data->size() : 0;
+}
+
+size_t File::read(uint8_t* buffer, size_t length) {
+  if (data == nullptr) {
+    return 0;
+  }
+  size_t count = std::min(length, data->size() - position);
+  memcpy(buffer, data->data() + position, count);
+  position += count;
+  return count;
+}
+
+void File::close() {
+  data = nullptr;
+  position = 0;
+}
+
+bool LittleFSFS::begin(bool formatOnFail) {
+  (void)formatOnFail;
+  return true;
+}
+
+bool LittleFSFS::exists(const char* path) {
+  return files.count(path) > 0;
+}
+
+File LittleFSFS::open(const char* path, const char* mode) {
+  (void)mode; // read only
+  auto entry = files.find(path);
+  return entry == files.end() ? File() : File(&entry->second);
+}
+
+/*************************************************************
+************************** TFT_eSPI **************************
+**************************************************************/
+
+TFT_eSPI::TFT_eSPI(int16_t width, int16_t height)
+    : panelWidth(width), panelHeight(height), viewWidth(width), viewHeight(height) {}
+
+void TFT_eSPI::init() {
+  setRotation(0);
+}
+
+void TFT_eSPI::setRotation(uint8_t rotation) {
+  bool landscape = (rotation & 1) != 0;
+  viewWidth = landscape ? panelHeight : panelWidth;
+  viewHeight = landscape ? panelWidth : panelHeight;
+}
+
+void TFT_eSPI::writecommand(uint8_t command) {
+  (void)command;
+  if (onPanel) {
+    displayStats.commands++;
+    panelBusy();
+  }
+}
+
+void TFT_eSPI::writedata(uint8_t data) {
+  (void)data; // parameters of the last command
+}
+
+void TFT_eSPI::setTextColor(uint16_t foreground, uint16_t background) {
+  (void)foreground;
+  (void)background;
+}
+
+void TFT_eSPI::setCursor(int16_t x, int16_t y) {
+  cursorX = x;
+  cursorY = y;
+}
+
+size_t TFT_eSPI::print(const char* text) {
+  countText(text, textFont);
+  cursorX += textWidth(text, textFont);
+  return strlen(text);
+}
+
+size_t TFT_eSPI::println(const char* text) {
+  size_t length = print(text);
+  cursorX = 0;
+  cursorY += fontHeight(textFont);
+  return length;
+}
+
+// Character cell of each font (the glyphs are proportional, so text pixels are an estimate)
+int16_t TFT_eSPI::textWidth(const char* text, uint8_t font) const {
+  int16_t cellWidth = (font == 4) ? 14 : (font == 2) ? 8 : 6;
+  return static_cast<int16_t>(strlen(text) * cellWidth);
+}
+
+int16_t TFT_eSPI::fontHeight(uint8_t font) const {
+  return (font == 4) ? 26 : (font == 2) ? 16 : 8;
+}
+
+void TFT_eSPI::countText(const char* text, uint8_t font) {
+  if (onPanel && text[0] != '\0') {
+    displayStats.text++;
+    displayStats.pixels += static_cast<uint64_t>(textWidth(text, font)) * fontHeight(font);
+    panelBusy();
+  }
+}
+
+void TFT_eSPI::fillScreen(uint32_t colour) {
+  fillRect(0, 0, viewWidth, viewHeight, colour);
+}
+
+void TFT_eSPI::fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t colour) {
+  (void)colour;
+  int32_t left = std::max<int32_t>(x, 0);
+  int32_t top = std::max<int32_t>(y, 0);
+  int32_t right = std::min<int32_t>(x + w, viewWidth);
+  int32_t bottom = std::min<int32_t>(y + h, viewHeight);
+  displayStats.fills++;
+  if (right > left && bottom > top) {
+    displayStats.pixels += static_cast<uint64_t>(right - left) * (bottom - top);
+  }
+  panelBusy();
+}
+
+int16_t TFT_eSPI::drawString(const char* text, int32_t x, int32_t y, uint8_t font) {
+  (void)x;
+  (void)y;
+  countText(text, font);
+  return textWidth(text, font);
+}
+
+int16_t TFT_eSPI::drawString(const char* text, int32_t x, int32_t y) {
+  return drawString(text, x, y, textFont);
+}
+
+void TFT_eSPI::pushImage(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t* data) {
+  (void)x;
+  (void)y;
+  (void)data;
+  displayStats.images++;
+  displayStats.pixels += static_cast<uint64_t>(w) * h;
+  panelBusy();
+}
+
+TFT_eSprite::TFT_eSprite(TFT_eSPI* tft) : TFT_eSPI(0, 0) {
+  (void)tft;
+  onPanel = false;
+}
+
+TFT_eSprite::~TFT_eSprite() {
+  deleteSprite();
+}
+
+void* TFT_eSprite::createSprite(int16_t width, int16_t height) {
+  deleteSprite();
+  pixels = static_cast<uint16_t*>(calloc(static_cast<size_t>(width) * height, sizeof(uint16_t)));
+  if (pixels != nullptr) {
+    panelWidth = viewWidth = width;
+    panelHeight = viewHeight = height;
+  }
+  return pixels;
+}
+
+void TFT_eSprite::deleteSprite() {
+  free(pixels);
+  pixels = nullptr;
+  panelWidth = viewWidth = 0;
+  panelHeight = viewHeight = 0;
+}
+
+void TFT_eSprite::fillSprite(uint32_t colour) {
+  fillRect(0, 0, viewWidth, viewHeight, colour);
+}
+
+void TFT_eSprite::fillScreen(uint32_t colour) {
+  fillSprite(colour);
+}
+
+void TFT_eSprite::fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t colour) {
+  if (pixels == nullptr) {
+    return;
+  }
+  for (int32_t row = std::max<int32_t>(y, 0); row < std::min<int32_t>(y + h, viewHeight); row++) {
+    for (int32_t column = std::max<int32_t>(x, 0); column < std::min<int32_t>(x + w, viewWidth); column++) {
+      pixels[row * viewWidth + column] = static_cast<uint16_t>(colour);
+    }
+  }
+}
+
+void TFT_eSprite::pushImage(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t* data) {
+  if (pixels == nullptr) {
+    return;
+  }
+  for (int32_t row = 0; row < h; row++) {
+    for (int32_t column = 0; column < w; column++) {
+      int32_t targetX = x + column;
+      int32_t targetY = y + row;
+      if (targetX >= 0 && targetX < viewWidth && targetY >= 0 && targetY < viewHeight) {
+        pixels[targetY * viewWidth + targetX] = data[row * w + column];
+      }
+    }
+  }
+}
+
+void TFT_eSprite::pushSprite(int32_t x, int32_t y) {
+  (void)x;
+  (void)y;
+  if (pixels != nullptr) {
+    displayStats.images++;
+    displayStats.pixels += static_cast<uint64_t>(viewWidth) * viewHeight;
+    panelBusy();
+  }
+}
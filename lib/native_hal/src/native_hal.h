@@ -0,0 +1,114 @@
+/*************************************************************
+************************* DEFINITIONS ************************
+**************************************************************/
+
+#ifndef NATIVE_HAL_H
+#define NATIVE_HAL_H
+
+// Host-side stand-in for the board, used by the native environment (pio test -e native).
+// The Arduino, ESP-IDF, FreeRTOS, Preferences, LittleFS and TFT_eSPI headers in this library are thin mocks that all run
+// on one virtual clock, so the firmware's state machine, sequencer and renderer build unchanged on the host.
+// This header is the side the tests drive and inspect:
+//   Clock   - virtual time; it only moves when the firmware blocks (task waits, light sleep, delays) or a
+//             test advances it, and esp_timer callbacks and scheduled pin changes fire as it passes them
+//   GPIO    - pin levels, interrupts and light sleep wake-ups
+//   LEDC    - latched duty per channel
+//   Display - operations and pixels sent to the panel (sprites only count when pushed), and how long each takes
+//   NVS     - flash writes made through Preferences
+//   Files   - the LittleFS partition, filled in by the test
+//   Reset   - the reason esp_reset_reason() gives for the last reset
+// Tasks are not run: the loop and display work are called by the test, one step at a time.
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Panel traffic counted by the TFT_eSPI mock
+struct DisplayStats {
+  uint32_t fills;    // fillScreen / fillRect
+  uint32_t images;   // pushImage / pushSprite
+  uint32_t text;     // drawString / print / println
+  uint32_t commands; // writecommand (register writes such as the scroll offset)
+  uint64_t pixels;   // pixels written to the panel (text is counted as its character cells)
+
+  uint32_t operations() const {
+    return fills + images + text + commands;
+  }
+};
+
+// Function to put the board back to power-on state: clock at 0, pins high, timers, queues, NVS and stats cleared,
+// reset reason power-on (files on the LittleFS partition are kept, as they would be across a reset - and so is RTC
+// memory, which is the firmware's own variables)
+void halReset();
+
+/*************************************************************
+*************************** CLOCK ****************************
+**************************************************************/
+
+// Function to get the virtual time in us (what esp_timer_get_time() and micros() return)
+int64_t halNowUs();
+
+// Function to move the clock forward, firing every timer and pin change that falls due on the way
+void halAdvanceUs(int64_t us);
+
+// Function to limit how far blocking waits and light sleep may move the clock (INT64_MAX = no limit)
+void halSetHorizonUs(int64_t timeUs);
+
+/*************************************************************
+**************************** GPIO ****************************
+**************************************************************/
+
+// Function to change an input pin now (runs its interrupt handler if one is attached and enabled)
+void halSetPin(int pin, int level);
+
+// Function to change an input pin at a later virtual time
+void halSchedulePin(int pin, int level, int64_t timeUs);
+
+// Function to read the level of a pin
+int halPinLevel(int pin);
+
+// Function to get how many times light sleep was entered, and how long was spent in it (us)
+uint32_t halSleepCount();
+int64_t halSleepTimeUs();
+
+/*************************************************************
+**************************** LEDC ****************************
+**************************************************************/
+
+// Function to get the duty latched on an LEDC channel, and how many times it was latched
+uint32_t halLedcDuty(int channel);
+uint32_t halLedcUpdates(int channel);
+
+/*************************************************************
+************************** DISPLAY ***************************
+**************************************************************/
+
+// Function to get the panel traffic since the last reset
+const DisplayStats &halDisplayStats();
+void halResetDisplayStats();
+
+// Function to make every panel operation take a while (moving the clock on), as a slow or stalled bus would -
+// halReset() sets it back to 0
+void halSetPanelDelayUs(int64_t us);
+
+/*************************************************************
+**************************** NVS *****************************
+**************************************************************/
+
+// Function to get how many values were written to flash through Preferences
+uint32_t halNvsWrites();
+
+/*************************************************************
+*************************** FILES ****************************
+**************************************************************/
+
+// Function to put a file on the LittleFS partition (as an uploaded filesystem image would), or remove it (nullptr)
+void halWriteFile(const char* path, const void* data, size_t length);
+
+/*************************************************************
+*************************** RESET ****************************
+**************************************************************/
+
+// Function to set the reason esp_reset_reason() gives (an esp_reset_reason_t) - halReset() sets power-on
+void halSetResetReason(int reason);
+
+#endif // NATIVE_HAL_H
@@ -0,0 +1,16 @@
+// GPIO register mock for the native build (see native_hal.h) - writes to the set/clear registers drive the
+// mocked pins
+
+#ifndef NATIVE_SOC_GPIO_REG_H
+#define NATIVE_SOC_GPIO_REG_H
+
+#include <stdint.h>
+
+#define GPIO_OUT_W1TS_REG 0x60004008
+#define GPIO_OUT_W1TC_REG 0x6000400C
+
+void halWriteRegister(uint32_t reg, uint32_t value);
+
+#define REG_WRITE(reg, value) halWriteRegister((reg), (value))
+
+#endif // NATIVE_SOC_GPIO_REG_H
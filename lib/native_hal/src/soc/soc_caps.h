@@ -0,0 +1,9 @@
+// SoC capability mock for the native build (see native_hal.h) - no dedicated GPIO, so the GPIO backend uses
+// the register path
+
+#ifndef NATIVE_SOC_CAPS_H
+#define NATIVE_SOC_CAPS_H
+
+#define SOC_DEDICATED_GPIO_SUPPORTED 0
+
+#endif // NATIVE_SOC_CAPS_H
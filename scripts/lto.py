@@ -0,0 +1,5 @@
+# Link-time optimisation for the firmware modules (see build_src_flags in platformio.ini).
+# The objects built from src/ carry GCC's intermediate code, so the link has to run the optimiser too.
+Import("env")
+
+env.Append(LINKFLAGS=["-flto", "-O2"])
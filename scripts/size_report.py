@@ -0,0 +1,37 @@
+# Memory size report for the firmware (pio run -e <env> -t size_report).
+# Sums the ELF's sections by memory region, so the effect of a build flag change (e.g. -O2 and LTO) on flash,
+# IRAM (the interrupt handlers and other IRAM_ATTR code), DRAM and RTC memory can be compared between commits.
+import subprocess
+
+Import("env")
+
+# Section name prefixes of each region (as laid out by the ESP32-S3 linker scripts)
+REGIONS = [
+    ("flash", (".flash.",)),          # code and constants run from flash
+    ("iram", (".iram0.",)),           # code loaded into internal RAM
+    ("dram", (".dram0.",)),           # data and bss in internal RAM
+    ("rtc", (".rtc.", ".rtc_noinit")), # RTC memory (the telemetry log)
+]
+
+
+def size_report(target, source, env):
+    elf = env.subst("$BUILD_DIR/${PROGNAME}.elf")
+    output = subprocess.check_output([env.subst("$SIZETOOL"), "-A", elf], universal_newlines=True)
+    totals = dict((name, 0) for name, _ in REGIONS)
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) < 2 or not fields[1].isdigit():
+            continue
+        for name, prefixes in REGIONS:
+            if fields[0].startswith(prefixes):
+                totals[name] += int(fields[1])
+    print("SIZE " + env.subst("$PIOENV") + " " + " ".join("%s=%d" % (name, totals[name]) for name, _ in REGIONS))
+
+
+env.AddCustomTarget(
+    name="size_report",
+    dependencies="$BUILD_DIR/${PROGNAME}.elf",
+    actions=size_report,
+    title="Size report",
+    description="Print flash, IRAM, DRAM and RTC memory use in bytes",
+)
@@ -0,0 +1,227 @@
+/*************************************************************
+************************* DEFINITIONS ************************
+**************************************************************/
+
+#include "audio.h"
+
+#ifdef ENABLE_AUDIO_MODE
+
+#include <esp_dsp.h>
+#include <math.h>
+#if ESP_IDF_VERSION_MAJOR >= 5
+#include <esp_adc/adc_continuous.h>
+#else
+#include <driver/adc.h>
+#endif
+
+#include "health.h"
+
+// Spectrum bins of each colour band (bin i is i * AUDIO_SAMPLE_RATE / AUDIO_FFT_SIZE Hz)
+constexpr int audioBin(int hz) {
+  return hz * AUDIO_FFT_SIZE / AUDIO_SAMPLE_RATE;
+}
+constexpr int bandEnds[3] = {audioBin(AUDIO_BASS_MAX_HZ), audioBin(AUDIO_MID_MAX_HZ), audioBin(AUDIO_TREBLE_MAX_HZ)};
+static_assert((AUDIO_FFT_SIZE & (AUDIO_FFT_SIZE - 1)) == 0, "AUDIO_FFT_SIZE must be a power of two");
+static_assert(bandEnds[0] > 1 && bandEnds[2] <= AUDIO_FFT_SIZE / 2, "colour bands must fit the spectrum");
+
+// Bytes of one frame of conversion results as the DMA delivers them
+#define AUDIO_RESULT_BYTES sizeof(adc_digi_output_data_t) // TYPE2 format: 4 bytes per sample on the ESP32-S3
+#define AUDIO_FRAME_BYTES (AUDIO_FFT_SIZE * AUDIO_RESULT_BYTES)
+
+std::atomic<uint32_t> audioFrames(0);
+std::atomic<uint32_t> audioOverruns(0);
+
+static TaskHandle_t audioTaskHandle = nullptr;
+static std::atomic<bool> audioSampling(false);     // set by the loop task, followed by the audio task
+#if ESP_IDF_VERSION_MAJOR >= 5
+static adc_continuous_handle_t adcHandle = nullptr;
+#endif
+
+// Frame buffers (audio task only)
+static uint8_t adcFrame[AUDIO_FRAME_BYTES];
+static float window[AUDIO_FFT_SIZE];
+alignas(16) static float spectrum[AUDIO_FFT_SIZE * 2]; // interleaved real and imaginary parts
+static float bandPeaks[3] = {AUDIO_NOISE_FLOOR, AUDIO_NOISE_FLOOR, AUDIO_NOISE_FLOOR};
+
+
+/*************************************************************
+********************** HELPER FUNCTIONS **********************
+**************************************************************/
+
+#if ESP_IDF_VERSION_MAJOR >= 5
+// ADC driver callback (ISR) - the DMA pool was full, so a frame was dropped
+static bool IRAM_ATTR onAudioOverrun(adc_continuous_handle_t handle, const adc_continuous_evt_data_t* data, void* arg) {
+  (void)handle;
+  (void)data;
+  (void)arg;
+  audioOverruns.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+#endif
+
+// Function to set up and start the continuous ADC on the audio pin
+static void startADC() {
+  adc_digi_pattern_config_t pattern = {};
+  pattern.atten = AUDIO_ADC_ATTEN;
+  pattern.channel = AUDIO_ADC_CHANNEL;
+  pattern.unit = AUDIO_ADC_UNIT;
+  pattern.bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+
+#if ESP_IDF_VERSION_MAJOR >= 5
+  adc_continuous_handle_cfg_t handleConfig = {};
+  handleConfig.max_store_buf_size = AUDIO_FRAME_BYTES * AUDIO_DMA_FRAMES;
+  handleConfig.conv_frame_size = AUDIO_FRAME_BYTES;
+  adc_continuous_new_handle(&handleConfig, &adcHandle);
+
+  adc_continuous_config_t config = {};
+  config.pattern_num = 1;
+  config.adc_pattern = &pattern;
+  config.sample_freq_hz = AUDIO_SAMPLE_RATE;
+  config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+  config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+  adc_continuous_config(adcHandle, &config);
+
+  adc_continuous_evt_cbs_t callbacks = {};
+  callbacks.on_pool_ovf = onAudioOverrun;
+  adc_continuous_register_event_callbacks(adcHandle, &callbacks, nullptr);
+  adc_continuous_start(adcHandle);
+#else
+  adc_digi_init_config_t initConfig = {};
+  initConfig.max_store_buf_size = AUDIO_FRAME_BYTES * AUDIO_DMA_FRAMES;
+  initConfig.conv_num_each_intr = AUDIO_FRAME_BYTES;
+  initConfig.adc1_chan_mask = BIT(AUDIO_ADC_CHANNEL);
+  adc_digi_initialize(&initConfig);
+
+  adc_digi_configuration_t config = {};
+  config.pattern_num = 1;
+  config.adc_pattern = &pattern;
+  config.sample_freq_hz = AUDIO_SAMPLE_RATE;
+  config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+  config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+  adc_digi_controller_configure(&config);
+  adc_digi_start();
+#endif
+}
+
+// Function to stop the continuous ADC and release the driver
+static void stopADC() {
+#if ESP_IDF_VERSION_MAJOR >= 5
+  adc_continuous_stop(adcHandle);
+  adc_continuous_deinit(adcHandle);
+  adcHandle = nullptr;
+#else
+  adc_digi_stop();
+  adc_digi_deinitialize();
+#endif
+}
+
+// Function to read one whole frame of samples into the spectrum buffer - returns false on a timeout
+static bool readAudioFrame() {
+  uint32_t length = 0;
+#if ESP_IDF_VERSION_MAJOR >= 5
+  esp_err_t result = adc_continuous_read(adcHandle, adcFrame, AUDIO_FRAME_BYTES, &length, AUDIO_FRAME_TIME * 2);
+#else
+  esp_err_t result = adc_digi_read_bytes(adcFrame, AUDIO_FRAME_BYTES, &length, AUDIO_FRAME_TIME * 2);
+  if (result == ESP_ERR_INVALID_STATE) {
+    audioOverruns.fetch_add(1, std::memory_order_relaxed); // the pool was full - the data read is still good
+    result = ESP_OK;
+  }
+#endif
+  if (result != ESP_OK) {
+    return false;
+  }
+
+  // Unpack the conversion results (a frame is one DMA transfer, so it is either all there or not at all)
+  int count = 0;
+  float sum = 0;
+  for (uint32_t i = 0; i + AUDIO_RESULT_BYTES <= length && count < AUDIO_FFT_SIZE; i += AUDIO_RESULT_BYTES) {
+    const adc_digi_output_data_t* sample = reinterpret_cast<const adc_digi_output_data_t*>(&adcFrame[i]);
+    if (sample->type2.channel != AUDIO_ADC_CHANNEL) {
+      continue;
+    }
+    spectrum[count * 2] = sample->type2.data;
+    sum += sample->type2.data;
+    count++;
+  }
+  if (count < AUDIO_FFT_SIZE) {
+    return false;
+  }
+
+  // Remove the bias (DC) and apply the window
+  float mean = sum / AUDIO_FFT_SIZE;
+  for (int i = 0; i < AUDIO_FFT_SIZE; i++) {
+    spectrum[i * 2] = (spectrum[i * 2] - mean) * window[i];
+    spectrum[i * 2 + 1] = 0;
+  }
+  return true;
+}
+
+// Function to turn the frame in the spectrum buffer into a colour (0xRRGGBB) - bass red, mids green, treble blue
+static int32_t spectrumColour() {
+  dsps_fft2r_fc32(spectrum, AUDIO_FFT_SIZE);
+  dsps_bit_rev_fc32(spectrum, AUDIO_FFT_SIZE);
+
+  int32_t colour = 0;
+  int bin = 1; // skip DC
+  for (int band = 0; band < 3; band++) {
+    float energy = 0;
+    for (; bin < bandEnds[band]; bin++) {
+      float re = spectrum[bin * 2];
+      float im = spectrum[bin * 2 + 1];
+      energy += re * re + im * im;
+    }
+
+    // Scale to the band's recent peak, which falls slowly so the colour adapts to the input level
+    float level = sqrtf(energy);
+    bandPeaks[band] = max(max(level, bandPeaks[band] * AUDIO_PEAK_DECAY), AUDIO_NOISE_FLOOR);
+    int value = static_cast<int>(level * 255.0f / bandPeaks[band] + 0.5f);
+    colour = (colour << 8) | min(value, 255);
+  }
+  return colour;
+}
+
+// Audio task - waits for audio mode, then turns every ADC frame into a colour for the loop task
+static void audioTask(void* parameter) {
+  (void)parameter;
+  watchCurrentTask();
+  for (;;) {
+    feedWatchdog();
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(HEALTH_FEED_INTERVAL)); // until setAudioSampling(true)
+    if (!audioSampling.load()) {
+      continue;
+    }
+
+    startADC();
+    while (audioSampling.load()) {
+      feedWatchdog(); // a read waits two frame times at most
+      if (readAudioFrame()) {
+        postEvent(EventType::AUDIO_FRAME, spectrumColour());
+        audioFrames.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    stopADC();
+  }
+}
+
+// Function to start the audio task (call once from setup() - the ADC stays off until audio mode is entered)
+void startAudio() {
+  dsps_fft2r_init_fc32(nullptr, AUDIO_FFT_SIZE);
+  dsps_wind_hann_f32(window, AUDIO_FFT_SIZE);
+  xTaskCreatePinnedToCore(audioTask, "audio", AUDIO_TASK_STACK_SIZE, nullptr, AUDIO_TASK_PRIORITY, &audioTaskHandle,
+                          AUDIO_TASK_CORE);
+  if (currentState == State::Colour_CHANGE_AUDIO) {
+    setAudioSampling(true); // restored from the settings
+  }
+}
+
+// Function to start or stop sampling (the loop task calls this on every mode change)
+void setAudioSampling(bool on) {
+  if (audioTaskHandle == nullptr || audioSampling.exchange(on) == on) {
+    return;
+  }
+  if (on) {
+    xTaskNotifyGive(audioTaskHandle); // stopping needs no wake-up - the task checks the flag every frame
+  }
+}
+
+#endif // ENABLE_AUDIO_MODE
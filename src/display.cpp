@@ -0,0 +1,774 @@
+/*************************************************************
+************************* DEFINITIONS ************************
+**************************************************************/
+
+#include <driver/ledc.h>
+#include <freertos/task.h>
+
+#include "display.h"
+#include "health.h"
+#include "input.h"
+#include "profiling.h" // timing probes (compiled out unless ENABLE_PROFILING is set)
+
+// Function to build a widget rectangle from layout arithmetic
+static constexpr Rect makeRect(int x, int y, int w, int h) {
+  return {static_cast<int16_t>(x), static_cast<int16_t>(y), static_cast<int16_t>(w), static_cast<int16_t>(h)};
+}
+
+// Function to compute the widget bounds for a rotation - the layout is a column of title, field rows and swatch,
+// with the history on the panel rows it scrolls in (across the bottom in portrait, down the right in landscape)
+static constexpr Layout computeLayout(uint8_t rotation) {
+  Layout result = {};
+  result.rotation = rotation;
+  result.landscape = (rotation == ROTATION_LANDSCAPE);
+  result.width = result.landscape ? TFT_HEIGHT : TFT_WIDTH;
+  result.height = result.landscape ? TFT_WIDTH : TFT_HEIGHT;
+
+  // In landscape (rotation 1) screen x is the panel row, so the history becomes a band of columns
+  int contentWidth = result.landscape ? HISTORY_Y : result.width;
+  int contentHeight = result.landscape ? result.height : HISTORY_Y;
+  result.widgets[WIDGET_HISTORY] = result.landscape ? makeRect(HISTORY_Y, 0, HISTORY_HEIGHT, result.height)
+                                                    : makeRect(0, HISTORY_Y, result.width, HISTORY_HEIGHT);
+
+  result.widgets[WIDGET_TITLE] = makeRect(0, 0, TITLE_WIDTH, TITLE_HEIGHT);
+  int rowY = result.landscape ? LANDSCAPE_ROW_Y : PORTRAIT_ROW_Y;
+  int rowPitch = result.landscape ? LANDSCAPE_ROW_PITCH : PORTRAIT_ROW_PITCH;
+  for (int i = 0; i < 3; i++) {
+    result.widgets[WIDGET_MODE_LABEL + i] = makeRect(0, rowY + i * rowPitch, FIELD_X, FIELD_HEIGHT);
+    result.widgets[WIDGET_MODE + i] = makeRect(FIELD_X, rowY + i * rowPitch, FIELD_WIDTH, FIELD_HEIGHT);
+  }
+  int rowsBottom = rowY + 2 * rowPitch + FIELD_HEIGHT;
+  result.dynamicArea = makeRect(FIELD_X, rowY, FIELD_WIDTH, rowsBottom - rowY);
+
+  int swatchY = rowsBottom + SWATCH_GAP;
+  result.widgets[WIDGET_SWATCH] = makeRect(0, swatchY, contentWidth, SWATCH_HEIGHT);
+  int overlayY = swatchY + SWATCH_HEIGHT + OVERLAY_GAP;
+  if (overlayY + OVERLAY_HEIGHT <= contentHeight) {
+    result.widgets[WIDGET_OVERLAY] = makeRect(0, overlayY, contentWidth, OVERLAY_HEIGHT);
+  }
+  return result;
+}
+
+static_assert(computeLayout(ROTATION_PORTRAIT).widgets[WIDGET_SWATCH].y + SWATCH_HEIGHT <= HISTORY_Y,
+              "the portrait layout must end above the history");
+static_assert(computeLayout(ROTATION_LANDSCAPE).widgets[WIDGET_SWATCH].y + SWATCH_HEIGHT <= TFT_WIDTH,
+              "the landscape layout must fit the short side of the panel");
+
+static Backlight backlightStage = Backlight::ON;
+
+QueueHandle_t displayQueue = nullptr; // single-slot mailbox holding the latest DisplayState
+std::atomic<bool> displayBusy(false); // true while the display task is rendering a snapshot
+std::atomic<bool> displayReady(false); // set once the display task has initialised the panel and backlight
+DisplayState latestState = {};         // copy of the last snapshot, for status reports from other tasks
+portMUX_TYPE statusLock = portMUX_INITIALIZER_UNLOCKED;
+
+Layout layout = computeLayout(ROTATION_PORTRAIT); // widget bounds for the current rotation (display task only)
+static uint8_t bootRotation = ROTATION_PORTRAIT;  // rotation the display task starts in (the saved setting)
+
+// Static layer - the title and field labels, rasterised once and blitted into place (they read the same in any
+// rotation, only their position changes)
+static const char* const titleLines[] = {"---------------------------", "  3-Colour LED Control", "---------------------------"};
+static const char* const fieldLabels[] = {"Mode: ", "Colour: ", "Button: "};
+static const uint16_t* staticLayer[STATIC_WIDGET_COUNT] = {}; // nullptr = printed from the font instead
+static_assert(sizeof(titleLines) / sizeof(titleLines[0]) * FIELD_HEIGHT == TITLE_HEIGHT, "title lines must fill the title");
+
+// Last value drawn in each dynamic field (-1/nullptr = not drawn yet, so the field is dirty)
+static int renderedMode = -1;
+static const char* renderedColourName = nullptr;
+static int renderedButton = -1;
+
+// A pre-rasterised label, kept in PSRAM in the panel's byte order so it can be pushed as-is
+struct LabelBitmap {
+  const char* text;       // matched by pointer - labels always come from modeName(), buttonStateName() or a sequence step
+  const uint16_t* pixels; // FIELD_WIDTH x FIELD_HEIGHT, shared by labels with the same text
+};
+
+static LabelBitmap labelCache[LABEL_CACHE_SIZE];
+static int labelCount = 0;
+
+#ifdef USE_SPRITE_RENDERER
+static TFT_eSprite* frameBuffers[2] = {nullptr, nullptr}; // dynamic area composed off-screen, alternated each frame
+static int backBuffer = 0;                                  // index of the buffer to compose the next frame into
+static bool spriteDMA = false;                              // true if frames are pushed with DMA
+#endif
+
+// Colour history, owned by the display task (a ring buffer - the newest entry is just before historyHead)
+static RGBColour colourHistory[HISTORY_LENGTH];
+int historyHead = 0;
+int historyCount = 0;
+static int historyScroll = HISTORY_Y;           // frame memory row currently shown at the top of the history area
+static const char* historyName = nullptr;       // step name of the newest history entry
+static RGBColour historyColour = {0, 0, 0};     // colour of the newest history entry
+static bool historyDirty = true;                // the history needs repainting from the ring buffer
+static int32_t renderedSwatch = -1;             // RGB565 colour in the swatch (-1 = not drawn yet)
+
+// Rendering mode of the last frame (display task only - the health monitor decides, see health.h)
+static bool renderingDegraded = false;          // text-only fields, no swatch or history
+
+
+/*************************************************************
+********************** HELPER FUNCTIONS **********************
+**************************************************************/
+
+// Function to time full-screen fills and print the panel bus configuration over serial
+void runDisplaySelfTest(TFT_eSPI &tft) {
+  const uint32_t fillColours[] = {TFT_RED, TFT_GREEN, TFT_BLUE, TFT_BLACK}; // finish on black
+  const int fillCount = sizeof(fillColours) / sizeof(fillColours[0]);
+
+  uint32_t startTime = micros();
+  for (int i = 0; i < fillCount; i++) {
+    tft.fillScreen(fillColours[i]);
+  }
+  uint32_t fillTime = (micros() - startTime) / fillCount;
+
+#if defined(TFT_PARALLEL_8_BIT)
+  const char* bus = "8-bit parallel";
+#elif defined(TFT_PARALLEL_16_BIT)
+  const char* bus = "16-bit parallel";
+#else
+  const char* bus = "SPI";
+#endif
+
+#ifdef USER_SETUP_ID
+  Serial.printf("TFT setup %d, %s bus, %dx%d\n", USER_SETUP_ID, bus, tft.width(), tft.height());
+#else
+  Serial.printf("TFT setup (library default), %s bus, %dx%d\n", bus, tft.width(), tft.height());
+#endif
+#ifdef SPI_FREQUENCY
+  Serial.printf("SPI frequency: %lu Hz\n", static_cast<unsigned long>(SPI_FREQUENCY));
+#endif
+  Serial.printf("Full-screen fill: %lu us (%lu fps max)\n",
+                static_cast<unsigned long>(fillTime), static_cast<unsigned long>(fillTime ? 1000000UL / fillTime : 0));
+}
+
+// Function to mark every dynamic field as dirty so the next update redraws them all
+void invalidateDynamicElements() {
+  renderedMode = -1;
+  renderedColourName = nullptr;
+  renderedButton = -1;
+  renderedSwatch = -1;
+  historyDirty = true;
+}
+
+// Function to get the text shown for a mode
+const char* modeName(State mode) {
+  switch (mode) {
+    case State::Colour_CHANGE_AUTO:
+      return "AUTO MODE";
+    case State::Colour_CHANGE_MANUAL:
+      return "MANUAL MODE";
+    case State::Colour_CHANGE_FADE:
+      return "FADE MODE";
+    case State::Colour_CHANGE_AUDIO:
+      return "AUDIO MODE";
+    case State::Colour_CHANGE_PATTERN:
+      return "PATTERN MODE";
+    default:
+      return "";
+  }
+}
+
+// Function to get the text shown for the button state
+const char* buttonStateName(bool pressed) {
+  return pressed ? "PRESSED" : "NOT PRESSED";
+}
+
+// Function to find the cached bitmap of a label (nullptr if it isn't cached)
+static const uint16_t* findLabel(const char* text) {
+  for (int i = 0; i < labelCount; i++) {
+    if (labelCache[i].text == text) {
+      return labelCache[i].pixels;
+    }
+  }
+  return nullptr;
+}
+
+// Function to rasterise one label into the cache
+static void cacheLabel(TFT_eSprite &scratch, const char* text) {
+  if (findLabel(text) != nullptr || labelCount >= LABEL_CACHE_SIZE) {
+    return;
+  }
+
+  // The same name in another sequence reuses the bitmap
+  for (int i = 0; i < labelCount; i++) {
+    if (strcmp(labelCache[i].text, text) == 0) {
+      labelCache[labelCount++] = {text, labelCache[i].pixels};
+      return;
+    }
+  }
+
+  uint16_t* pixels = static_cast<uint16_t*>(ps_malloc(LABEL_BYTES));
+  if (pixels == nullptr) {
+    return; // no PSRAM - the label is drawn from the font instead
+  }
+
+  scratch.fillSprite(TFT_BLACK);
+  scratch.setTextColor(TFT_WHITE, TFT_BLACK);
+  scratch.drawString(text, 0, 0, 2);
+  memcpy(pixels, scratch.getPointer(), LABEL_BYTES);
+  labelCache[labelCount++] = {text, pixels};
+}
+
+// Function to pre-rasterise every label the dynamic fields can show (call once, before the display task starts)
+void buildLabelCache(TFT_eSPI &tft) {
+  TFT_eSprite scratch(&tft);
+  scratch.setColorDepth(16);
+  if (scratch.createSprite(FIELD_WIDTH, FIELD_HEIGHT) == nullptr) {
+    return;
+  }
+
+  const State modes[] = {State::Colour_CHANGE_AUTO, State::Colour_CHANGE_MANUAL, State::Colour_CHANGE_FADE,
+                         State::Colour_CHANGE_AUDIO, State::Colour_CHANGE_PATTERN};
+  for (State mode : modes) {
+    cacheLabel(scratch, modeName(mode));
+  }
+  cacheLabel(scratch, buttonStateName(false));
+  cacheLabel(scratch, buttonStateName(true));
+  cacheLabel(scratch, customColourName);
+
+  for (int i = 0; i < SEQUENCE_COUNT; i++) {
+    for (int j = 0; j < sequences[i].length; j++) {
+      cacheLabel(scratch, sequences[i].steps[j].name);
+    }
+  }
+
+  scratch.deleteSprite();
+}
+
+// Function to rasterise one static widget (lines of font 2) - returns nullptr if there is no PSRAM for it
+static const uint16_t* rasteriseStaticWidget(TFT_eSPI &tft, const Rect &bounds, const char* const* lines, int lineCount) {
+  TFT_eSprite scratch(&tft);
+  scratch.setColorDepth(16);
+  if (scratch.createSprite(bounds.w, bounds.h) == nullptr) {
+    return nullptr;
+  }
+
+  size_t bytes = static_cast<size_t>(bounds.w) * bounds.h * 2;
+  uint16_t* pixels = static_cast<uint16_t*>(ps_malloc(bytes));
+  if (pixels != nullptr) {
+    scratch.fillSprite(TFT_BLACK);
+    scratch.setTextColor(TFT_WHITE, TFT_BLACK);
+    for (int i = 0; i < lineCount; i++) {
+      scratch.drawString(lines[i], 0, i * FIELD_HEIGHT, 2);
+    }
+    memcpy(pixels, scratch.getPointer(), bytes);
+  }
+  scratch.deleteSprite();
+  return pixels;
+}
+
+// Function to get the text of a static widget
+static const char* const* staticWidgetLines(int widget, int &lineCount) {
+  if (widget == WIDGET_TITLE) {
+    lineCount = sizeof(titleLines) / sizeof(titleLines[0]);
+    return titleLines;
+  }
+  lineCount = 1;
+  return &fieldLabels[widget - WIDGET_MODE_LABEL];
+}
+
+// Function to rasterise the static layer (call once - the bitmaps are the same in every rotation)
+void buildStaticLayer(TFT_eSPI &tft) {
+  for (int i = 0; i < STATIC_WIDGET_COUNT; i++) {
+    if (staticLayer[i] == nullptr) {
+      int lineCount;
+      const char* const* lines = staticWidgetLines(i, lineCount);
+      staticLayer[i] = rasteriseStaticWidget(tft, layout.widgets[i], lines, lineCount);
+    }
+  }
+}
+
+// Function to draw the static layer - one blit per widget (clearScreen = false if the screen is known to be black
+// already; the history is never cleared, it is repainted from its ring buffer)
+void drawStaticElements(TFT_eSPI &tft, bool clearScreen) {
+  if (clearScreen) {
+    const Rect &history = layout.widgets[WIDGET_HISTORY];
+    if (layout.landscape) {
+      tft.fillRect(0, 0, history.x, layout.height, TFT_BLACK);
+    } else {
+      tft.fillRect(0, 0, layout.width, history.y, TFT_BLACK);
+    }
+  }
+  tft.setTextFont(2);                     // set the font size
+  tft.setTextColor(TFT_WHITE, TFT_BLACK); // set text color and background
+
+  for (int i = 0; i < STATIC_WIDGET_COUNT; i++) {
+    const Rect &bounds = layout.widgets[i];
+    if (staticLayer[i] != nullptr) {
+      tft.pushImage(bounds.x, bounds.y, bounds.w, bounds.h, staticLayer[i]);
+      continue;
+    }
+
+    int lineCount;
+    const char* const* lines = staticWidgetLines(i, lineCount);
+    for (int j = 0; j < lineCount; j++) {
+      tft.drawString(lines[j], bounds.x, bounds.y + j * FIELD_HEIGHT, 2);
+    }
+  }
+
+  invalidateDynamicElements(); // every widget needs drawing again in its (possibly new) bounds
+}
+
+// Function to redraw a single dynamic field as plain text (a fill and a text draw)
+static void drawTextField(TFT_eSPI &tft, const Rect &bounds, const char* text) {
+  tft.fillRect(bounds.x, bounds.y, bounds.w, bounds.h, TFT_BLACK); // clear previous text
+  tft.drawString(text, bounds.x, bounds.y, 2);
+}
+
+// Function to update the dynamic fields in the degraded rendering mode - the fields that changed are drawn as plain
+// text straight onto the panel, with either renderer
+static void updateTextElements(TFT_eSPI &tft, const DisplayState &state) {
+#if defined(USE_SPRITE_RENDERER) && defined(ESP32_DMA)
+  if (spriteDMA) {
+    tft.dmaWait(); // drawing straight onto the panel must not overlap a frame transfer
+  }
+#endif
+
+  int mode = static_cast<int>(state.mode);
+  int button = state.buttonPressed ? 1 : 0;
+  tft.setTextColor(TFT_WHITE, TFT_BLACK);
+
+  if (mode != renderedMode) {
+    drawTextField(tft, layout.widgets[WIDGET_MODE], modeName(state.mode));
+    renderedMode = mode;
+  }
+  if (state.colourName != renderedColourName) {
+    drawTextField(tft, layout.widgets[WIDGET_COLOUR], state.colourName);
+    renderedColourName = state.colourName;
+  }
+  if (button != renderedButton) {
+    drawTextField(tft, layout.widgets[WIDGET_BUTTON], buttonStateName(state.buttonPressed));
+    renderedButton = button;
+  }
+}
+
+#ifdef USE_SPRITE_RENDERER
+// Function to draw one field into a frame (a straight copy if the label is cached)
+static void drawFrameField(TFT_eSprite &frame, int32_t y, const char* text) {
+  const uint16_t* label = findLabel(text);
+  if (label != nullptr) {
+    frame.pushImage(0, y, FIELD_WIDTH, FIELD_HEIGHT, label);
+  } else {
+    frame.drawString(text, 0, y, 2);
+  }
+}
+
+// Function to create the off-screen frame buffers for the dynamic area (called again after a rotation to resize them)
+void setupRenderer(TFT_eSPI &tft) {
+  if (frameBuffers[0] == nullptr) {
+#ifdef ESP32_DMA
+    spriteDMA = tft.initDMA();
+#endif
+    for (int i = 0; i < 2; i++) {
+      frameBuffers[i] = new TFT_eSprite(&tft);
+      // DMA can only read internal RAM, so PSRAM is only used when frames are pushed by the CPU
+      frameBuffers[i]->setAttribute(PSRAM_ENABLE, !spriteDMA);
+      frameBuffers[i]->setColorDepth(16);
+    }
+    if (spriteDMA) {
+      tft.startWrite(); // hold the bus so DMA transfers can run in the background
+    }
+  }
+#ifdef ESP32_DMA
+  if (spriteDMA) {
+    tft.dmaWait(); // the last frame may still be in flight from one of the buffers
+  }
+#endif
+
+  for (int i = 0; i < 2; i++) {
+    frameBuffers[i]->deleteSprite();
+    frameBuffers[i]->createSprite(layout.dynamicArea.w, layout.dynamicArea.h);
+  }
+}
+
+// Function to update dynamic elements on the TFT screen - composed in a sprite and pushed in one transfer
+void updateDynamicElements(TFT_eSPI &tft, const DisplayState &state) {
+  int mode = static_cast<int>(state.mode);
+  int button = state.buttonPressed ? 1 : 0;
+
+  if (mode == renderedMode && state.colourName == renderedColourName && button == renderedButton) {
+    return; // nothing on screen is out of date
+  }
+
+  // Compose the whole dynamic area into the back buffer (the other buffer may still be in flight)
+  const Rect &area = layout.dynamicArea;
+  TFT_eSprite &frame = *frameBuffers[backBuffer];
+  frame.fillSprite(TFT_BLACK);
+  frame.setTextColor(TFT_WHITE, TFT_BLACK);
+  drawFrameField(frame, layout.widgets[WIDGET_MODE].y - area.y, modeName(state.mode));
+  drawFrameField(frame, layout.widgets[WIDGET_COLOUR].y - area.y, state.colourName);
+  drawFrameField(frame, layout.widgets[WIDGET_BUTTON].y - area.y, buttonStateName(state.buttonPressed));
+
+#ifdef ESP32_DMA
+  if (spriteDMA) {
+    // Waits for the previous transfer, then returns as soon as this one has started
+    tft.pushImageDMA(area.x, area.y, area.w, area.h, static_cast<uint16_t*>(frame.getPointer()));
+  } else
+#endif
+  {
+    frame.pushSprite(area.x, area.y);
+  }
+#ifndef ESP32_DMA
+  (void)tft;
+#endif
+  backBuffer ^= 1;
+
+  renderedMode = mode;
+  renderedColourName = state.colourName;
+  renderedButton = button;
+}
+#else
+// Function to set up the renderer (nothing to do when drawing straight onto the panel)
+void setupRenderer(TFT_eSPI &tft) {
+  (void)tft;
+}
+
+// Function to redraw a single dynamic field (one image push if the label is cached, otherwise a fill and a text draw)
+static void drawField(TFT_eSPI &tft, const Rect &bounds, const char* text) {
+  const uint16_t* label = findLabel(text);
+  if (label != nullptr) {
+    tft.pushImage(bounds.x, bounds.y, bounds.w, bounds.h, label); // the background is part of the bitmap
+    return;
+  }
+  drawTextField(tft, bounds, text);
+}
+
+// Function to update dynamic elements on the TFT screen - only fields that changed are redrawn
+void updateDynamicElements(TFT_eSPI &tft, const DisplayState &state) {
+  int mode = static_cast<int>(state.mode);
+  int button = state.buttonPressed ? 1 : 0;
+
+  bool modeDirty = (mode != renderedMode);
+  bool colourDirty = (state.colourName != renderedColourName);
+  bool buttonDirty = (button != renderedButton);
+
+  if (!modeDirty && !colourDirty && !buttonDirty) {
+    return; // nothing on screen is out of date
+  }
+
+  tft.setTextColor(TFT_WHITE, TFT_BLACK);
+
+  // Update the mode (Auto/Manual)
+  if (modeDirty) {
+    drawField(tft, layout.widgets[WIDGET_MODE], modeName(state.mode));
+    renderedMode = mode;
+  }
+
+  // Update the current LED colour
+  if (colourDirty) {
+    drawField(tft, layout.widgets[WIDGET_COLOUR], state.colourName);
+    renderedColourName = state.colourName;
+  }
+
+  // Update the button state
+  if (buttonDirty) {
+    drawField(tft, layout.widgets[WIDGET_BUTTON], buttonStateName(state.buttonPressed));
+    renderedButton = button;
+  }
+}
+#endif // USE_SPRITE_RENDERER
+
+// Function to point the top of the history area at a frame memory row
+static void setHistoryScroll(TFT_eSPI &tft, int row) {
+  historyScroll = row;
+  tft.writecommand(ST7789_VSCRSADD);
+  tft.writedata(row >> 8);
+  tft.writedata(row & 0xFF);
+}
+
+// Function to make the history area the panel's hardware scroll region (call once after tft.init())
+void setupColourHistory(TFT_eSPI &tft) {
+  tft.writecommand(ST7789_VSCRDEF);
+  tft.writedata(HISTORY_Y >> 8); // top fixed area - everything above the history
+  tft.writedata(HISTORY_Y & 0xFF);
+  tft.writedata(HISTORY_HEIGHT >> 8); // scroll area
+  tft.writedata(HISTORY_HEIGHT & 0xFF);
+  tft.writedata(0); // no bottom fixed area
+  tft.writedata(0);
+  setHistoryScroll(tft, HISTORY_Y);
+}
+
+// Function to fill one strip of the history, given its first panel row
+static void fillHistoryStrip(TFT_eSPI &tft, int row, uint16_t colour) {
+  const Rect &history = layout.widgets[WIDGET_HISTORY];
+  if (layout.landscape) {
+    tft.fillRect(row, history.y, HISTORY_STRIP_HEIGHT, history.h, colour); // panel rows are screen columns
+  } else {
+    tft.fillRect(history.x, row, history.w, HISTORY_STRIP_HEIGHT, colour);
+  }
+}
+
+// Function to repaint the whole history from the ring buffer (after the screen was cleared)
+static void redrawColourHistory(TFT_eSPI &tft) {
+  setHistoryScroll(tft, HISTORY_Y);
+  for (int i = 0; i < HISTORY_LENGTH; i++) {
+    uint16_t colour = TFT_BLACK;
+    if (i < historyCount) {
+      const RGBColour &entry = colourHistory[(historyHead - 1 - i + HISTORY_LENGTH) % HISTORY_LENGTH];
+      colour = tft.color565(entry.r, entry.g, entry.b);
+    }
+    fillHistoryStrip(tft, HISTORY_Y + i * HISTORY_STRIP_HEIGHT, colour);
+  }
+}
+
+// Function to add a colour to the top of the history - the panel scrolls the older strips down,
+// so only the new strip is filled
+static void pushColourHistory(TFT_eSPI &tft, const RGBColour &colour) {
+  colourHistory[historyHead] = colour;
+  historyHead = (historyHead + 1) % HISTORY_LENGTH;
+  if (historyCount < HISTORY_LENGTH) {
+    historyCount++;
+  }
+
+  // The rows above the current top hold the oldest strip (shown at the bottom), which is reused for the new one
+  int row = historyScroll - HISTORY_STRIP_HEIGHT;
+  if (row < HISTORY_Y) {
+    row += HISTORY_HEIGHT;
+  }
+  fillHistoryStrip(tft, row, tft.color565(colour.r, colour.g, colour.b));
+  setHistoryScroll(tft, row);
+}
+
+// Function to fill the swatch with the colour on the LED (skipped if the RGB565 value hasn't changed)
+static void drawSwatch(TFT_eSPI &tft, const RGBColour &colour) {
+  int32_t swatch = tft.color565(colour.r, colour.g, colour.b);
+  if (swatch != renderedSwatch) {
+    const Rect &bounds = layout.widgets[WIDGET_SWATCH];
+    tft.fillRect(bounds.x, bounds.y, bounds.w, bounds.h, swatch);
+    renderedSwatch = swatch;
+  }
+}
+
+// Function to update the swatch and history for a snapshot - mid-fade the swatch shows the level actually on the LED
+void updateColourPreview(TFT_eSPI &tft, const DisplayState &state) {
+  if (renderingDegraded) {
+    return; // text-only until the display is back on time
+  }
+#if defined(USE_SPRITE_RENDERER) && defined(ESP32_DMA)
+  if (spriteDMA) {
+    tft.dmaWait(); // drawing straight onto the panel must not overlap a frame transfer
+  }
+#endif
+
+  if (historyDirty) {
+    redrawColourHistory(tft);
+    historyDirty = false;
+  }
+  bool colourChanged = state.rgb.r != historyColour.r || state.rgb.g != historyColour.g || state.rgb.b != historyColour.b;
+  if (state.colourName != historyName || colourChanged) {
+    pushColourHistory(tft, state.rgb);
+    historyName = state.colourName;
+    historyColour = state.rgb;
+  }
+
+  RGBColour colour = state.rgb;
+  readFadeColour(colour);
+  drawSwatch(tft, colour);
+}
+
+// Function to send the current state to the display task (never blocks - a pending snapshot is replaced)
+void publishDisplayState(int64_t eventTimeUs) {
+  if (displayQueue == nullptr) {
+    return; // the display task isn't running (benchmarks)
+  }
+
+  const char* colourName = customColour ? customColourName : activeSequence->steps[currentStep].name;
+  DisplayState state = {currentState, colourName, currentRGB, buttonPressed, settings.rotation, eventTimeUs, {},
+                        settings.autoPeriodMs, settings.brightness};
+  strncpy(state.sequenceName, activeSequence->name, sizeof(state.sequenceName) - 1);
+
+  portENTER_CRITICAL(&statusLock);
+  latestState = state;
+  portEXIT_CRITICAL(&statusLock);
+  xQueueOverwrite(displayQueue, &state);
+}
+
+// Function to set up PWM on the backlight pin (call after tft.init(), which claims the pin as a plain output)
+void setupBacklight() {
+  ledc_channel_config_t channelConfig = {};
+  channelConfig.gpio_num = PIN_LCD_BL;
+  channelConfig.speed_mode = LED_PWM_MODE;
+  channelConfig.channel = BACKLIGHT_CHANNEL;
+  channelConfig.intr_type = LEDC_INTR_DISABLE;
+  channelConfig.timer_sel = LED_PWM_TIMER;
+  channelConfig.duty = levelToDuty(settings.brightness); // start at the saved brightness
+  channelConfig.hpoint = 0;
+  ledc_channel_config(&channelConfig);
+
+  backlightStage = Backlight::ON;
+  lastActivityTime = millis();
+}
+
+// Function to set the backlight brightness (0-255, perceived brightness)
+void setBacklightLevel(uint8_t level) {
+  ledc_set_duty(LED_PWM_MODE, BACKLIGHT_CHANNEL, levelToDuty(level));
+  ledc_update_duty(LED_PWM_MODE, BACKLIGHT_CHANNEL);
+}
+
+// Function to bring up the panel for the display task - runs after setup() has already put the colour on the LED
+// and started the button handling, so a slow panel init never delays first light or input
+void initDisplay(TFT_eSPI &tft) {
+  // Keep the panel dark until the layout is on it - TFT_eSPI isn't given TFT_BL, so init() leaves the pin alone and
+  // the backlight's LEDC channel (setupBacklight()) is the only thing that turns it on
+  pinMode(PIN_LCD_BL, OUTPUT);
+  digitalWrite(PIN_LCD_BL, LOW);
+  tft.init();
+  renderingDegraded = false;
+  tft.setRotation(bootRotation); // the saved rotation (portrait or landscape)
+  layout = computeLayout(bootRotation);
+  runDisplaySelfTest(tft); // time full-screen fills and report the bus in use (leaves the screen black)
+  tft.setTextFont(2);      // set the font size
+  tft.setTextColor(TFT_WHITE, TFT_BLACK);
+
+  buildStaticLayer(tft);     // rasterise the title and field labels once, so the static layout is blitted
+  buildLabelCache(tft);      // rasterise every label once, so redraws just push bitmaps
+  setupRenderer(tft);        // direct drawing or sprite + DMA, chosen in platformio.ini
+  drawStaticElements(tft, false); // the self test already left the screen black
+  setupColourHistory(tft);   // the colour history scrolls in hardware, so only the newest strip is ever drawn
+  setupBacklight();          // light the panel only once the layout is on it
+  displayReady.store(true);
+
+  int64_t readyTime = esp_timer_get_time();
+  Serial.printf("Boot: LED on %lu us, input ready %lu us, display ready %lu us\n",
+                static_cast<unsigned long>(bootLEDTime), static_cast<unsigned long>(bootInputTime),
+                static_cast<unsigned long>(readyTime));
+}
+
+// Function to switch the screen to another rotation - the widget bounds are recomputed and the static layer is
+// blitted into its new place; every other widget then redraws its own bounds on the next update
+void applyRotation(TFT_eSPI &tft, uint8_t rotation) {
+  tft.setRotation(rotation);
+  layout = computeLayout(rotation);
+  setupRenderer(tft);      // the dynamic area may have changed shape
+  drawStaticElements(tft); // clears everything but the history, which is repainted from its ring buffer
+}
+
+// Function to switch between full and degraded (text-only) rendering
+static void setRenderingDegraded(TFT_eSPI &tft, bool degraded) {
+  renderingDegraded = degraded;
+  if (degraded) {
+#if defined(USE_SPRITE_RENDERER) && defined(ESP32_DMA)
+    if (spriteDMA) {
+      tft.dmaWait();
+    }
+#endif
+    // Blank the swatch and history rather than leave stale colours on them
+    const Rect &swatch = layout.widgets[WIDGET_SWATCH];
+    const Rect &history = layout.widgets[WIDGET_HISTORY];
+    tft.fillRect(swatch.x, swatch.y, swatch.w, swatch.h, TFT_BLACK);
+    tft.fillRect(history.x, history.y, history.w, history.h, TFT_BLACK);
+  }
+  renderedSwatch = -1; // both are repainted when full rendering comes back
+  historyDirty = true;
+}
+
+// Function to draw one snapshot - the fields that changed, the history and the swatch (or only the fields, as text,
+// while the health monitor has the rendering degraded)
+void renderDisplayState(TFT_eSPI &tft, const DisplayState &state) {
+  displayBusy.store(true);
+  PROFILE_START(PROFILE_RENDER);
+  int64_t startUs = esp_timer_get_time();
+  if (state.rotation != layout.rotation) {
+    applyRotation(tft, state.rotation);
+  }
+  if (displayDegraded.load() != renderingDegraded) {
+    setRenderingDegraded(tft, !renderingDegraded);
+  }
+  if (renderingDegraded) {
+    updateTextElements(tft, state);
+  } else {
+    updateDynamicElements(tft, state);
+    updateColourPreview(tft, state);
+  }
+  reportFrame(checkDeadline(HEALTH_FRAME, startUs)); // decides the mode of the next frame
+  PROFILE_END(PROFILE_RENDER);
+  PROFILE_RECORD_US(PROFILE_LATENCY, esp_timer_get_time() - state.eventTimeUs);
+  displayBusy.store(false);
+}
+
+// Display task - sets up the panel, then sleeps until a new snapshot arrives and redraws whatever changed
+static void displayTask(void* parameter) {
+  TFT_eSPI &tft = *static_cast<TFT_eSPI*>(parameter);
+  DisplayState state;
+  bool stateReceived = false;
+
+  displayBusy.store(true); // keep the loop out of light sleep until the panel is up
+  initDisplay(tft);
+  displayBusy.store(false);
+  watchCurrentTask(); // a stalled panel transfer from here on resets the board
+
+#ifdef PROFILE_OVERLAY
+  const TickType_t idleWaitTime = pdMS_TO_TICKS(PROFILE_OVERLAY_INTERVAL); // wake up to refresh the overlay
+  TickType_t lastOverlayTime = 0;
+#else
+  const TickType_t idleWaitTime = pdMS_TO_TICKS(HEALTH_FEED_INTERVAL); // wake up to feed the watchdog
+#endif
+
+  for (;;) {
+    feedWatchdog();
+    bool fadeFrames = fadeRunning() && !displayDegraded.load(); // degraded rendering has no swatch to fade
+    TickType_t waitTime = fadeFrames ? pdMS_TO_TICKS(SWATCH_FRAME_INTERVAL) : idleWaitTime;
+
+    if (xQueueReceive(displayQueue, &state, waitTime) == pdTRUE) {
+      stateReceived = true;
+      renderDisplayState(tft, state);
+      if (displayDegraded.load()) {
+        vTaskDelay(pdMS_TO_TICKS(HEALTH_DEGRADED_FRAME_INTERVAL)); // snapshots meanwhile are merged in the mailbox
+      }
+    } else if (stateReceived) {
+      updateColourPreview(tft, state); // fade frame - only the swatch changes
+    }
+#ifdef PROFILE_OVERLAY
+    if (xTaskGetTickCount() - lastOverlayTime >= idleWaitTime) {
+      lastOverlayTime = xTaskGetTickCount();
+      if (layout.widgets[WIDGET_OVERLAY].h > 0) {
+        drawProfileOverlay(tft, layout.widgets[WIDGET_OVERLAY].y); // left out in landscape, where there is no room
+      }
+    }
+#endif
+  }
+}
+
+// Function to start the display task - it owns the TFT from here on, including its initialisation
+void startDisplayTask(TFT_eSPI &tft) {
+  bootRotation = settings.rotation; // read here, before commands can change it
+  displayQueue = xQueueCreate(1, sizeof(DisplayState));
+  xTaskCreatePinnedToCore(displayTask, "display", DISPLAY_TASK_STACK_SIZE, &tft,
+                          DISPLAY_TASK_PRIORITY, nullptr, DISPLAY_TASK_CORE);
+}
+
+// Function to set the backlight to the level of its current stage (after the stage or the brightness changed)
+void refreshBacklight() {
+  if (!displayReady.load()) {
+    return; // setupBacklight() starts it at the saved brightness
+  }
+
+  uint8_t dimLevel = min(settings.brightness, static_cast<uint8_t>(BACKLIGHT_DIM_LEVEL));
+  setBacklightLevel(backlightStage == Backlight::ON ? settings.brightness : backlightStage == Backlight::DIM ? dimLevel : 0);
+}
+
+// Function to dim / switch off the backlight after the idle timeouts - returns ms until the next stage is due
+uint32_t updateBacklight() {
+  if (!displayReady.load()) {
+    return BACKLIGHT_DIM_TIMEOUT; // the display task hasn't set the backlight up yet
+  }
+
+  uint32_t idleTime = millis() - lastActivityTime;
+  Backlight stage = (idleTime >= BACKLIGHT_OFF_TIMEOUT) ? Backlight::OFF
+                  : (idleTime >= BACKLIGHT_DIM_TIMEOUT) ? Backlight::DIM
+                                                        : Backlight::ON;
+
+  if (stage != backlightStage) {
+    backlightStage = stage;
+    refreshBacklight();
+  }
+
+  switch (stage) {
+    case Backlight::ON:
+      return BACKLIGHT_DIM_TIMEOUT - idleTime;
+    case Backlight::DIM:
+      return BACKLIGHT_OFF_TIMEOUT - idleTime;
+    default:
+      return portMAX_DELAY; // already off - nothing more to do until the button is pressed
+  }
+}
@@ -0,0 +1,210 @@
+/*************************************************************
+************************* DEFINITIONS ************************
+**************************************************************/
+
+#include "fleet_sync.h"
+
+#ifdef ENABLE_FLEET_SYNC
+
+#include <WiFi.h>
+#include <esp_now.h>
+#include <esp_wifi.h>
+
+std::atomic<uint32_t> fleetBeacons(0);
+std::atomic<uint32_t> fleetAlignments(0);
+std::atomic<int32_t> fleetPhaseError(0);
+
+#ifdef FLEET_SYNC_LEADER
+static const uint8_t broadcastAddress[ESP_NOW_ETH_ALEN] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+static esp_timer_handle_t beaconTimer = nullptr;
+static uint8_t beaconCount = 0; // esp_timer task only
+#else
+static FleetBeacon latestBeacon = {};  // written by the Wi-Fi task, read by the loop task
+static int64_t latestBeaconTime = 0;   // esp_timer time (us) the latest beacon arrived
+static portMUX_TYPE beaconLock = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
+
+/*************************************************************
+********************** HELPER FUNCTIONS **********************
+**************************************************************/
+
+// Function to get the index of a sequence in sequences[] - -1 for an uploaded sequence
+static int sequenceIndex(const Sequence* sequence) {
+  return sequence == &uploadedSequence ? -1 : static_cast<int>(sequence - sequences);
+}
+
+#ifdef FLEET_SYNC_LEADER
+// Beacon timer callback (esp_timer task) - broadcasts where the schedule is, if there is one to follow
+static void onBeaconTimer(void* arg) {
+  (void)arg;
+  AutoSchedule schedule; // the loop task owns the sequence and the settings - only the scheduler's snapshot is read
+  if (!getAutoSchedule(schedule) || sequenceIndex(schedule.sequence) < 0) {
+    return; // followers run on their own until the leader is back in auto or fade mode
+  }
+
+  int64_t remainingUs = schedule.stepEndUs - esp_timer_get_time();
+  FleetBeacon beacon = {};
+  beacon.magic = FLEET_BEACON_MAGIC;
+  beacon.sequence = static_cast<uint8_t>(sequenceIndex(schedule.sequence));
+  beacon.step = static_cast<uint8_t>(schedule.step);
+  beacon.count = beaconCount++;
+  beacon.remainingUs = static_cast<uint32_t>(remainingUs > 0 ? remainingUs : 0);
+  beacon.periodMs = schedule.periodMs;
+  if (esp_now_send(broadcastAddress, reinterpret_cast<const uint8_t*>(&beacon), sizeof(beacon)) == ESP_OK) {
+    fleetBeacons.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+#else
+// Function to get where in the active sequence's cycle a step ends (ms from the start of step 0)
+static int64_t stepEndOffset(int step) {
+  int64_t offset = 0;
+  for (int i = 0; i <= step; i++) {
+    offset += stepDuration(i);
+  }
+  return offset;
+}
+
+// Function to check if the follower's mode runs on the auto colour schedule the leader's beacons describe
+static bool followingLeader() {
+  return currentState == State::Colour_CHANGE_AUTO || currentState == State::Colour_CHANGE_FADE;
+}
+
+// Function to keep a beacon for the loop task (Wi-Fi task) - the mode, the sequence and the settings it is checked
+// against are the loop task's, so it is only validated here
+static void handleBeacon(const uint8_t* data, int length) {
+  FleetBeacon beacon;
+  if (length != static_cast<int>(sizeof(beacon))) {
+    return;
+  }
+  memcpy(&beacon, data, sizeof(beacon));
+  if (beacon.magic != FLEET_BEACON_MAGIC || beacon.sequence >= SEQUENCE_COUNT ||
+      beacon.step >= sequences[beacon.sequence].length) {
+    return;
+  }
+
+  int64_t receivedUs = esp_timer_get_time();
+  portENTER_CRITICAL(&beaconLock);
+  latestBeacon = beacon;
+  latestBeaconTime = receivedUs;
+  portEXIT_CRITICAL(&beaconLock);
+  fleetBeacons.fetch_add(1, std::memory_order_relaxed);
+  postEvent(EventType::FLEET_BEACON);
+}
+
+// Function to restart the auto schedule on a beacon (loop task)
+static void alignToLeader(const FleetBeacon &beacon, int64_t receivedUs) {
+  // Take the leader's sequence and period over (the scheduler reads both, so it is stopped first)
+  stopAutoColour();
+  if (activeSequence != &sequences[beacon.sequence] || settings.autoPeriodMs != beacon.periodMs) {
+    activeSequence = &sequences[beacon.sequence];
+    settings.autoPeriodMs = beacon.periodMs;
+    markSettingsDirty();
+  }
+
+  // Walk the leader's schedule forward from the beacon to the step it is on now
+  int step = beacon.step;
+  int64_t stepEndUs = receivedUs - FLEET_LINK_LATENCY_US + beacon.remainingUs;
+  int64_t now = esp_timer_get_time();
+  while (stepEndUs <= now) {
+    step = (step + 1) % activeSequence->length;
+    stepEndUs += static_cast<int64_t>(stepDuration(step)) * 1000;
+  }
+
+  if (step != currentStep || customColour) {
+    applySequenceStep(step);
+  }
+  startAutoColourAt(step, stepEndUs);
+  fleetAlignments.fetch_add(1, std::memory_order_relaxed);
+}
+
+// ESP-NOW receive callback (Wi-Fi task)
+#if ESP_IDF_VERSION_MAJOR >= 5
+static void onBeaconReceived(const esp_now_recv_info_t* info, const uint8_t* data, int length) {
+  (void)info;
+  handleBeacon(data, length);
+}
+#else
+static void onBeaconReceived(const uint8_t* mac, const uint8_t* data, int length) {
+  (void)mac;
+  handleBeacon(data, length);
+}
+#endif
+#endif // FLEET_SYNC_LEADER
+
+// Function to start ESP-NOW and the leader's beacons or the follower's receive callback (call once from setup())
+void startFleetSync() {
+  WiFi.mode(WIFI_STA);
+#ifndef ENABLE_REMOTE_CONTROL
+  esp_wifi_set_channel(FLEET_CHANNEL, WIFI_SECOND_CHAN_NONE); // with remote control every board joins the same AP
+#endif
+  if (esp_now_init() != ESP_OK) {
+    Serial.println("Fleet sync: could not start ESP-NOW");
+    return;
+  }
+
+#ifdef FLEET_SYNC_LEADER
+  esp_now_peer_info_t peer = {};
+  memcpy(peer.peer_addr, broadcastAddress, ESP_NOW_ETH_ALEN);
+  peer.channel = 0; // the current channel
+  peer.ifidx = WIFI_IF_STA;
+  esp_now_add_peer(&peer);
+
+  esp_timer_create_args_t timerArgs = {};
+  timerArgs.callback = onBeaconTimer;
+  timerArgs.dispatch_method = ESP_TIMER_TASK;
+  timerArgs.name = "fleet_beacon";
+  esp_timer_create(&timerArgs, &beaconTimer);
+  esp_timer_start_periodic(beaconTimer, static_cast<uint64_t>(FLEET_BEACON_INTERVAL) * 1000);
+  Serial.println("Fleet sync: leader");
+#else
+  esp_wifi_set_ps(WIFI_PS_NONE); // modem sleep would miss beacons
+  esp_now_register_recv_cb(onBeaconReceived);
+  Serial.println("Fleet sync: follower");
+#endif
+}
+
+// Function to check the leader's latest beacon against the local schedule (loop task, on a FLEET_BEACON event) -
+// nudges the scheduler, or realigns when the error is too large to slew out
+void handleFleetBeacon() {
+#ifdef FLEET_SYNC_LEADER
+  // the leader has no one to follow
+#else
+  FleetBeacon beacon;
+  int64_t receivedUs;
+  portENTER_CRITICAL(&beaconLock);
+  beacon = latestBeacon;
+  receivedUs = latestBeaconTime;
+  portEXIT_CRITICAL(&beaconLock);
+
+  AutoSchedule schedule;
+  if (receivedUs == 0 || !followingLeader() || !getAutoSchedule(schedule)) {
+    return;
+  }
+  if (beacon.sequence != sequenceIndex(activeSequence) || beacon.periodMs != settings.autoPeriodMs) {
+    alignToLeader(beacon, receivedUs); // a different sequence or period - take the leader's over
+    return;
+  }
+
+  // Phase error = the leader's position in the cycle less ours, wrapped to the nearest half cycle
+  int64_t leaderEndUs = receivedUs - FLEET_LINK_LATENCY_US + beacon.remainingUs;
+  int64_t cycleUs = stepEndOffset(activeSequence->length - 1) * 1000;
+  int64_t errorUs = (stepEndOffset(beacon.step) * 1000 - leaderEndUs) -
+                    (stepEndOffset(schedule.step) * 1000 - schedule.stepEndUs);
+  errorUs %= cycleUs;
+  if (errorUs > cycleUs / 2) {
+    errorUs -= cycleUs;
+  } else if (errorUs < -cycleUs / 2) {
+    errorUs += cycleUs;
+  }
+  fleetPhaseError.store(static_cast<int32_t>(errorUs), std::memory_order_relaxed); // half a cycle fits in 32 bits
+
+  if (errorUs > FLEET_LOCK_WINDOW_US || errorUs < -FLEET_LOCK_WINDOW_US) {
+    alignToLeader(beacon, receivedUs);
+  } else {
+    nudgeAutoColour(static_cast<int32_t>(errorUs)); // the scheduler slews it out over the coming steps
+  }
+#endif
+}
+
+#endif // ENABLE_FLEET_SYNC
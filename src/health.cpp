@@ -0,0 +1,116 @@
+/*************************************************************
+************************* DEFINITIONS ************************
+**************************************************************/
+
+#include <esp_idf_version.h>
+#include <esp_task_wdt.h>
+#include <esp_timer.h>
+
+#include "health.h"
+
+HealthMonitor healthMonitors[HEALTH_DEADLINE_COUNT] = {
+  {"input", HEALTH_INPUT_DEADLINE * 1000, {0}, {0}},
+  {"led_step", HEALTH_LED_DEADLINE * 1000, {0}, {0}},
+  {"frame", HEALTH_FRAME_DEADLINE * 1000, {0}, {0}}
+};
+
+std::atomic<bool> displayDegraded(false);
+
+// Frames in a row over or on time (display task only)
+static uint32_t lateFrames = 0;
+static uint32_t onTimeFrames = 0;
+
+
+/*************************************************************
+********************** HELPER FUNCTIONS **********************
+**************************************************************/
+
+// Function to set the task watchdog up and subscribe the loop task to it (call once from setup())
+void startHealthMonitor() {
+  // The Arduino core has usually started the watchdog already - reconfigure it to reset the board on a timeout
+#if ESP_IDF_VERSION_MAJOR >= 5
+  esp_task_wdt_config_t config = {};
+  config.timeout_ms = HEALTH_WATCHDOG_TIMEOUT;
+  config.idle_core_mask = 1 << 0; // keep watching core 0's idle task, as the Arduino core does
+  config.trigger_panic = true;
+  if (esp_task_wdt_reconfigure(&config) != ESP_OK) {
+    esp_task_wdt_init(&config);
+  }
+#else
+  esp_task_wdt_init(HEALTH_WATCHDOG_TIMEOUT / 1000, true); // initialises or reconfigures it
+#endif
+  watchCurrentTask();
+
+  for (HealthMonitor &monitor : healthMonitors) {
+    monitor.misses.store(0);
+    monitor.worstUs.store(0);
+  }
+  lateFrames = 0;
+  onTimeFrames = 0;
+  displayDegraded.store(false);
+}
+
+// Function to subscribe the calling task to the task watchdog
+void watchCurrentTask() {
+  esp_task_wdt_add(nullptr);
+}
+
+// Function to unsubscribe the calling task from the task watchdog (before it deletes itself)
+void unwatchCurrentTask() {
+  esp_task_wdt_delete(nullptr);
+}
+
+// Function to feed the task watchdog for the calling task (once per pass of the task's loop)
+void feedWatchdog() {
+  esp_task_wdt_reset();
+}
+
+// Function to check the time since startUs (esp_timer time) against a deadline - returns false (and counts a miss)
+// if it was overrun
+bool checkDeadline(HealthDeadline deadline, int64_t startUs) {
+  HealthMonitor &monitor = healthMonitors[deadline];
+  int64_t elapsedUs = esp_timer_get_time() - startUs;
+  uint32_t elapsed = elapsedUs < UINT32_MAX ? static_cast<uint32_t>(elapsedUs) : UINT32_MAX;
+
+  if (elapsed > monitor.worstUs.load(std::memory_order_relaxed)) {
+    monitor.worstUs.store(elapsed, std::memory_order_relaxed); // only the deadline's own task writes it
+  }
+  if (elapsed <= monitor.limitUs) {
+    return true;
+  }
+  monitor.misses.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+// Function to track rendered frames (display task) - returns true while rendering should be degraded
+bool reportFrame(bool onTime) {
+  if (onTime) {
+    lateFrames = 0;
+    onTimeFrames++;
+  } else {
+    onTimeFrames = 0;
+    lateFrames++;
+  }
+
+  bool degraded = displayDegraded.load(std::memory_order_relaxed);
+  if (!degraded && lateFrames >= HEALTH_DEGRADE_MISSES) {
+    degraded = true;
+    Serial.println("Health: display overrunning, rendering degraded");
+  } else if (degraded && onTimeFrames >= HEALTH_RECOVER_FRAMES) {
+    degraded = false;
+    Serial.println("Health: display on time, full rendering restored");
+  }
+  displayDegraded.store(degraded, std::memory_order_relaxed);
+  return degraded;
+}
+
+// Function to print the deadlines over serial, one line each:
+// HEALTH <name> limit_us=<us> misses=<n> worst_us=<us>
+void reportHealth() {
+  for (int i = 0; i < HEALTH_DEADLINE_COUNT; i++) {
+    const HealthMonitor &monitor = healthMonitors[i];
+    Serial.printf("HEALTH %s limit_us=%lu misses=%lu worst_us=%lu\n", monitor.name,
+                  static_cast<unsigned long>(monitor.limitUs), static_cast<unsigned long>(monitor.misses.load()),
+                  static_cast<unsigned long>(monitor.worstUs.load()));
+  }
+}
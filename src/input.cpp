@@ -0,0 +1,374 @@
+/*************************************************************
+************************* DEFINITIONS ************************
+**************************************************************/
+
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+
+#include "display.h"
+#include "fleet_sync.h" // ESP-NOW fleet sync (compiled out unless ENABLE_FLEET_SYNC is set)
+#include "health.h"
+#include "input.h"
+#include "pattern.h"
+#include "profiling.h" // timing probes (compiled out unless ENABLE_PROFILING is set)
+#include "telemetry.h"
+
+static uint32_t lastButtonEdgeMs = 0; // millis() time the last edge was processed
+uint32_t lastButtonPressUs = 0;       // micros() timestamp of the last press edge
+uint32_t lastButtonPressDurationUs = 0;
+uint32_t lastActivityTime = 0;        // millis() time of the last button activity (for the backlight timeout)
+
+
+/*************************************************************
+*********************** GESTURE ENGINE ***********************
+**************************************************************/
+
+// Function to forget any gesture in progress (the button is taken as released)
+void ButtonGestures::reset() {
+  raw = false;
+  down = false;
+  changeUs = INT64_MIN / 2;
+  count = 0;
+  longPressed = false;
+  held = false;
+  clickPending = false;
+}
+
+// Function to call the handler attached to a gesture, if there is one
+void ButtonGestures::fire(Gesture gesture, uint8_t presses) {
+  GestureHandler handler = handlers[static_cast<int>(gesture)];
+  if (handler != nullptr) {
+    handler(presses);
+  }
+}
+
+// Function to take on a new debounced level and fire the gestures it starts or ends
+void ButtonGestures::accept(bool pressed, int64_t timeUs) {
+  bool sameBurst = (timeUs - changeUs) < static_cast<int64_t>(timing.multiClickMs) * 1000; // time since the release
+  down = pressed;
+  changeUs = timeUs;
+
+  if (pressed) {
+    count = (sameBurst && count > 0 && count < UINT8_MAX) ? count + 1 : 1;
+    longPressed = false;
+    held = false;
+    clickPending = false;
+    nextRepeatUs = timeUs + static_cast<int64_t>(timing.repeatDelayMs) * 1000;
+    fire(Gesture::PRESS, count);
+    if (handlers[static_cast<int>(Gesture::MULTI_CLICK)] == nullptr) {
+      fire(Gesture::CLICK, count); // no second click to wait for - fire on press-down
+    }
+  } else if (held) {
+    count = 0; // a long press or hold-repeat ends the burst
+  } else if (handlers[static_cast<int>(Gesture::MULTI_CLICK)] != nullptr) {
+    clickPending = true; // resolved by tick() once the multi-click time has passed
+  }
+}
+
+// Function to apply the raw button level from an edge - a change during the debounce time is picked up by tick()
+void ButtonGestures::update(bool pressed, int64_t timeUs) {
+  raw = pressed;
+  if (pressed != down && timeUs - changeUs >= static_cast<int64_t>(timing.debounceMs) * 1000) {
+    accept(pressed, timeUs);
+  }
+}
+
+// Function to run the gesture timers (call every BUTTON_TICK_INTERVAL ms while the engine isn't idle)
+void ButtonGestures::tick(int64_t nowUs) {
+  update(raw, nowUs); // the level may have settled somewhere else while bounce was being ignored
+
+  if (down) {
+    if (!longPressed && nowUs - changeUs >= static_cast<int64_t>(timing.longPressMs) * 1000) {
+      longPressed = true;
+      held = true;
+      fire(Gesture::LONG_PRESS, count);
+    }
+    if (handlers[static_cast<int>(Gesture::REPEAT)] != nullptr && nowUs >= nextRepeatUs) {
+      held = true;
+      nextRepeatUs += static_cast<int64_t>(timing.repeatIntervalMs) * 1000;
+      fire(Gesture::REPEAT, count);
+    }
+  } else if (clickPending && nowUs - changeUs >= static_cast<int64_t>(timing.multiClickMs) * 1000) {
+    uint8_t presses = count;
+    clickPending = false;
+    count = 0;
+    fire(presses == 1 ? Gesture::CLICK : Gesture::MULTI_CLICK, presses);
+  }
+}
+
+
+/*************************************************************
+********************** HELPER FUNCTIONS **********************
+**************************************************************/
+
+// Button interrupt - posts every edge on GPIO14 with its timestamp
+static void IRAM_ATTR onButtonEdge() {
+  postEventFromISR(EventType::BUTTON_EDGE, !digitalRead(BUTTON_PIN)); // active LOW
+}
+
+// Function to attach the button interrupt (call from the task that runs loop())
+void setupButtonInterrupt() {
+  loopTaskHandle = xTaskGetCurrentTaskHandle();
+  attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), onButtonEdge, CHANGE);
+}
+
+// Function to check if the gesture engine still needs ticking (gesture in progress or edges still settling)
+bool buttonNeedsTick(ButtonGestures &button) {
+  return !button.isIdle() || buttonPressed || (millis() - lastButtonEdgeMs < BUTTON_SETTLE_TIME);
+}
+
+// Function to bring the button state (and the screen) in line with the debounced level
+static void syncButtonState(ButtonGestures &button) {
+  bool pressed = button.isPressed();
+  if (pressed == buttonPressed) {
+    return;
+  }
+
+  uint32_t changeTimeUs = static_cast<uint32_t>(button.changeTimeUs()); // same time base as micros()
+  if (pressed) {
+    lastButtonPressUs = changeTimeUs;
+  } else {
+    lastButtonPressDurationUs = changeTimeUs - lastButtonPressUs;
+  }
+
+  buttonPressed = pressed;
+  postEvent(EventType::BUTTON_CHANGED, pressed); // update screen
+}
+
+// Function to apply one button edge to the gesture engine
+void handleButtonEdge(ButtonGestures &button, const Event &edge) {
+  button.update(edge.value != 0, edge.timeUs);
+  syncButtonState(button);
+}
+
+// Function to dispatch every queued event in order, then send the display one snapshot for the whole batch
+void dispatchEvents(ButtonGestures &button) {
+  int64_t startUs = esp_timer_get_time();
+  if (!eventsPending() && buttonNeedsTick(button)) {
+    PROFILE_START(PROFILE_BUTTON);
+    button.tick(esp_timer_get_time()); // run the gesture timers (debounce, multi-click, long press and repeat)
+    syncButtonState(button);
+    PROFILE_END(PROFILE_BUTTON);
+  }
+
+  Event event;
+  bool edgeSeen = false;
+  bool redraw = false;
+  int64_t batchTimeUs = 0; // oldest cause of the changes in this batch
+
+  // Handlers can post more events (a press changes the colour, a long press the mode) - they are dispatched here too
+  while (popEvent(event)) {
+    dispatchTimeUs = event.timeUs;
+    logTelemetryEvent(event); // before it is handled, so a crash in the handler leaves it as the last record
+    switch (event.type) {
+      case EventType::BUTTON_EDGE: {
+        PROFILE_START(PROFILE_BUTTON);
+        handleButtonEdge(button, event);
+        PROFILE_END(PROFILE_BUTTON);
+        edgeSeen = true;
+        break;
+      }
+      case EventType::AUTO_STEP:
+        handleAutoStep(event);
+        checkDeadline(HEALTH_LED_STEP, event.timeUs); // from the timer firing to the step on the LED
+        break;
+      case EventType::PATTERN_TICK:
+        handlePatternTick(event);
+        checkDeadline(HEALTH_LED_STEP, event.timeUs);
+        break;
+      case EventType::BRIGHTNESS_CHANGED:
+        refreshBacklight();
+        break;
+#ifdef ENABLE_AUDIO_MODE
+      case EventType::AUDIO_FRAME:
+        handleAudioFrame(event);
+        break;
+#endif
+#ifdef ENABLE_FLEET_SYNC
+      case EventType::FLEET_BEACON:
+        handleFleetBeacon();
+        break;
+#endif
+      case EventType::LOAD_PATTERN_FILE:
+        handlePatternFile();
+        break;
+      case EventType::MODE_CHANGED:
+        attachGestures(button); // the gestures on offer depend on the mode
+        [[fallthrough]];
+      case EventType::COLOUR_CHANGED:
+      case EventType::BUTTON_CHANGED:
+      case EventType::ROTATION_CHANGED:
+        if (!redraw || event.timeUs < batchTimeUs) {
+          batchTimeUs = event.timeUs;
+        }
+        redraw = true;
+        break;
+      default:
+        handleCommand(event);
+        break;
+    }
+  }
+  dispatchTimeUs = 0;
+
+  if (edgeSeen) {
+    lastButtonEdgeMs = millis();
+    lastActivityTime = lastButtonEdgeMs;
+  }
+  if (redraw) {
+    publishDisplayState(batchTimeUs);
+  }
+  checkDeadline(HEALTH_INPUT, startUs);
+}
+
+// Function to work out how long the main loop can sleep before it next has work to do
+uint32_t nextWakeDelay(ButtonGestures &button) {
+  if (eventsPending()) {
+    return 0; // there are still events to dispatch
+  }
+  if (buttonNeedsTick(button)) {
+    return BUTTON_TICK_INTERVAL;
+  }
+  return portMAX_DELAY; // nothing happens until the button interrupt or the auto colour timer fires
+}
+
+// Function to block the main loop until the button interrupt fires or the timeout (ms) expires
+void waitForInput(uint32_t timeoutMs) {
+  if (timeoutMs == 0) {
+    return;
+  }
+  ulTaskNotifyTake(pdTRUE, timeoutMs == portMAX_DELAY ? portMAX_DELAY : pdMS_TO_TICKS(timeoutMs));
+}
+
+// Function to check that nothing will be running while the chip sleeps
+bool canLightSleep(ButtonGestures &button) {
+#ifdef DISABLE_LIGHT_SLEEP
+  (void)button;
+  return false;
+#else
+  return !eventsPending() && !fadeRunning() && !buttonNeedsTick(button) &&
+         currentState != State::Colour_CHANGE_AUDIO && // the continuous ADC stops in light sleep
+         !displayBusy.load() && uxQueueMessagesWaiting(displayQueue) == 0;
+#endif
+}
+
+// Function to light sleep until the button is pressed or the timeout (ms) expires - the LED stays on (LEDC)
+void enterLightSleep(uint32_t timeoutMs) {
+  // Use the button as a level wake source only while asleep, then give it back to the edge interrupt
+  gpio_intr_disable(static_cast<gpio_num_t>(BUTTON_PIN));
+  gpio_wakeup_enable(static_cast<gpio_num_t>(BUTTON_PIN), GPIO_INTR_LOW_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+  if (timeoutMs != portMAX_DELAY) {
+    esp_sleep_enable_timer_wakeup(static_cast<uint64_t>(timeoutMs) * 1000);
+  }
+
+  esp_light_sleep_start();
+
+  esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);
+  gpio_wakeup_disable(static_cast<gpio_num_t>(BUTTON_PIN));
+  gpio_set_intr_type(static_cast<gpio_num_t>(BUTTON_PIN), GPIO_INTR_ANYEDGE);
+  gpio_intr_enable(static_cast<gpio_num_t>(BUTTON_PIN));
+
+  // The press that woke us happened while the edge interrupt was off, so pick it up here
+  if (!digitalRead(BUTTON_PIN) && !buttonPressed) {
+    postEvent(EventType::BUTTON_EDGE, 1);
+  }
+}
+
+// Function to idle until the next event - light sleeps when nothing is running, otherwise blocks the loop task
+void idleUntilNextEvent(ButtonGestures &button) {
+  uint32_t timeoutMs = nextWakeDelay(button);
+  timeoutMs = min(timeoutMs, updateBacklight());
+  timeoutMs = min(timeoutMs, serviceSettings()); // changed settings are written out while the loop is idle
+  timeoutMs = min(timeoutMs, static_cast<uint32_t>(HEALTH_FEED_INTERVAL)); // wake in time to feed the watchdog
+
+  if (timeoutMs == 0) {
+    return;
+  }
+
+  if (canLightSleep(button)) {
+    uint32_t sleepMs = timeoutMs;
+    sleepMs = min(sleepMs, nextAutoStepDelay()); // wake in time for the next auto colour step
+    sleepMs = min(sleepMs, nextPatternDelay());  // or pattern tick
+    if (sleepMs >= LIGHT_SLEEP_MIN_TIME) {
+      enterLightSleep(sleepMs);
+      return;
+    }
+  }
+
+  waitForInput(timeoutMs);
+}
+
+// Button gestures
+// Function to attach the gestures for the current mode. Manual mode has no multi-click, so a press steps the colour
+// on press-down, and a double press held scrolls through the colours; in the automatic modes a double click steps
+// the brightness and a triple click goes back to full brightness. A long press changes modes in every mode.
+void attachGestures(ButtonGestures &button) {
+  bool manual = (currentState == State::Colour_CHANGE_MANUAL);
+  button.setTiming({GESTURE_DEBOUNCE_TIME, GESTURE_MULTI_CLICK_TIME, settings.longPressMs, GESTURE_REPEAT_DELAY,
+                    GESTURE_REPEAT_INTERVAL});
+  button.attach(Gesture::CLICK, onShortPress);
+  button.attach(Gesture::MULTI_CLICK, manual ? nullptr : onMultiClick);
+  button.attach(Gesture::REPEAT, manual ? onHoldRepeat : nullptr);
+  button.attach(Gesture::LONG_PRESS, onLongPressStart);
+}
+
+// Colour shown before the last manual press-down step, put back if that press becomes a long press
+static int pressStartStep = 0;
+static bool pressStartCustom = false;
+static RGBColour pressStartRGB = {0, 0, 0};
+
+void onShortPress(uint8_t count) { // change colours in manual mode with short presses
+  (void)count;
+  if (currentState == State::Colour_CHANGE_MANUAL) {
+    pressStartStep = currentStep;
+    pressStartCustom = customColour;
+    pressStartRGB = currentRGB;
+    changeColour(); // posts the colour change for the screen
+    markSettingsDirty();
+  }
+}
+
+void onMultiClick(uint8_t count) { // step the LED and screen brightness with a double click, reset it with a triple
+  if (count == 2) {
+    stepBrightness(); // wraps back to full
+  } else if (count == 3) {
+    setBrightness(255);
+  }
+}
+
+void onHoldRepeat(uint8_t count) { // scroll through the colours in manual mode while a double press is held
+  if (count >= 2 && currentState == State::Colour_CHANGE_MANUAL) {
+    changeColour();
+    markSettingsDirty();
+  }
+}
+
+void onLongPressStart(uint8_t count) { // change modes with a 1sec long press (Auto -> Fade -> Manual [-> Audio, Pattern] -> Auto)
+  if (count != 1) {
+    return; // the held press of a combo
+  }
+
+  switch (currentState) {
+    case State::Colour_CHANGE_AUTO:
+      setMode(State::Colour_CHANGE_FADE);
+      break;
+    case State::Colour_CHANGE_FADE:
+      setMode(State::Colour_CHANGE_MANUAL);
+      break;
+    case State::Colour_CHANGE_MANUAL:
+      // The press stepped the colour on press-down - undo it, so the next mode starts from the colour it left
+      if (pressStartCustom) {
+        setLEDRGB(pressStartRGB.r, pressStartRGB.g, pressStartRGB.b);
+      } else {
+        applySequenceStep(pressStartStep);
+      }
+      setMode(modeAvailable(State::Colour_CHANGE_AUDIO) ? State::Colour_CHANGE_AUDIO : State::Colour_CHANGE_PATTERN);
+      break; // setMode() goes on to auto mode if neither is available
+    case State::Colour_CHANGE_AUDIO:
+      setMode(State::Colour_CHANGE_PATTERN);
+      break;
+    default:
+      setMode(State::Colour_CHANGE_AUTO);
+      break;
+  }
+}
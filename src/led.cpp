@@ -0,0 +1,176 @@
+/*************************************************************
+************************* DEFINITIONS ************************
+**************************************************************/
+
+#include <esp_sleep.h>
+#include <freertos/FreeRTOS.h>
+
+#include "led.h"
+
+// LED output tables - the one not in use is rebuilt and then swapped in under fadeLock. Every LED write reads the
+// table under fadeLock too, so once a swap is done no write can still be using the table it replaced, and the next
+// rebuild (loop task only) never changes a table a write is reading
+static DutyTable ledDutyTables[2];
+std::atomic<const DutyTable*> ledDutyTable(&cieTable); // full brightness until setLEDBrightness() is called
+
+// Fade state, shared by the loop task and the fade timer
+static esp_timer_handle_t fadeTimer = nullptr;
+static portMUX_TYPE fadeLock = portMUX_INITIALIZER_UNLOCKED; // guards the fade state and every LED write, so
+                                                             // a stale fade frame can't land after a direct write
+static uint16_t fadeLevel[3] = {0, 0, 0};   // level (8.8 fixed point) currently on each channel
+static uint16_t fadeFrom[3] = {0, 0, 0};    // level each channel started the fade at
+static uint16_t fadeTo[3] = {0, 0, 0};      // level each channel ends the fade at
+static int64_t fadeStartTime = 0;           // esp_timer time (us) the fade started
+static uint32_t fadeDuration = 0;           // fade length in us
+static bool fadeActive = false;
+
+
+/*************************************************************
+********************** HELPER FUNCTIONS **********************
+**************************************************************/
+
+// Function to set up the LEDC timer shared by the LED channels and the backlight
+void setupPWMTimer() {
+  ledc_timer_config_t timerConfig = {};
+  timerConfig.speed_mode = LED_PWM_MODE;
+  timerConfig.duty_resolution = static_cast<ledc_timer_bit_t>(LED_PWM_RESOLUTION);
+  timerConfig.timer_num = LED_PWM_TIMER;
+  timerConfig.freq_hz = LED_PWM_FREQ;
+#ifdef DISABLE_LIGHT_SLEEP
+  timerConfig.clk_cfg = LEDC_AUTO_CLK;
+#else
+  timerConfig.clk_cfg = LED_PWM_SLEEP_CLK; // keeps the LED lit while the chip is in light sleep
+  esp_sleep_pd_config(LED_PWM_SLEEP_PD_DOMAIN, ESP_PD_OPTION_ON);
+#endif
+  ledc_timer_config(&timerConfig);
+}
+
+// Function to set up the LED output selected in platformio.ini (LEDC PWM by default)
+void setupLEDOutput() {
+  setupPWMTimer(); // also used by the backlight
+  LEDOutput::begin();
+}
+
+// Function to set the LED brightness (0-255, perceived brightness) - scales every colour level in lightness, so
+// colours keep their hue and each brightness step looks the same size
+void setLEDBrightness(uint8_t brightness) {
+  const DutyTable* active = ledDutyTable.load(std::memory_order_relaxed);
+  const DutyTable* next = &cieTable;
+  if (brightness != 255) {
+    DutyTable &table = (active == &ledDutyTables[0]) ? ledDutyTables[1] : ledDutyTables[0];
+    for (int i = 0; i < 256; i++) {
+      table.duty[i] = levelToDuty(static_cast<uint8_t>((i * brightness + 127) / 255));
+    }
+    next = &table;
+  }
+
+  portENTER_CRITICAL(&fadeLock); // waits out a write that is still reading the old table
+  ledDutyTable.store(next, std::memory_order_release);
+  portEXIT_CRITICAL(&fadeLock);
+}
+
+// Fade timer callback (esp_timer task) - moves every channel one frame along the fade
+void onFadeTimer(void* arg) {
+  (void)arg;
+  uint16_t levels[3];
+  bool finished;
+
+  portENTER_CRITICAL(&fadeLock);
+  if (!fadeActive) {
+    portEXIT_CRITICAL(&fadeLock);
+    return;
+  }
+
+  int64_t elapsed = esp_timer_get_time() - fadeStartTime;
+  finished = (elapsed >= fadeDuration);
+  uint32_t progress = finished ? 65536 : static_cast<uint32_t>((elapsed << 16) / fadeDuration); // 0.16 fixed point
+
+  for (int i = 0; i < 3; i++) {
+    int32_t delta = static_cast<int32_t>(fadeTo[i]) - fadeFrom[i];
+    fadeLevel[i] = fadeFrom[i] + static_cast<int32_t>((static_cast<int64_t>(delta) * progress) >> 16);
+    levels[i] = fadeLevel[i];
+  }
+  LEDOutput::writeLevels(levels); // under the lock - a direct write either lands after it or cancels it
+  fadeActive = !finished;
+  portEXIT_CRITICAL(&fadeLock);
+
+  LEDOutput::flush();
+  if (finished) {
+    esp_timer_stop(fadeTimer);
+  }
+}
+
+// Function to create the fade timer
+void setupFadeTimer() {
+  esp_timer_create_args_t timerArgs = {};
+  timerArgs.callback = onFadeTimer;
+  timerArgs.dispatch_method = ESP_TIMER_TASK;
+  timerArgs.name = "fade";
+  esp_timer_create(&timerArgs, &fadeTimer);
+}
+
+// Function to start a crossfade from whatever is on the LED now to a new colour
+void startFade(const RGBColour &target, uint32_t durationMs) {
+  esp_timer_stop(fadeTimer); // restart cleanly if a fade is already running
+
+  portENTER_CRITICAL(&fadeLock);
+  const uint8_t levels[3] = {target.r, target.g, target.b};
+  for (int i = 0; i < 3; i++) {
+    fadeFrom[i] = fadeLevel[i]; // continue from mid-fade if one was interrupted
+    fadeTo[i] = static_cast<uint16_t>(levels[i]) << 8;
+  }
+  fadeStartTime = esp_timer_get_time();
+  fadeDuration = durationMs > 0 ? durationMs * 1000 : 1;
+  fadeActive = true;
+  portEXIT_CRITICAL(&fadeLock);
+
+  esp_timer_start_periodic(fadeTimer, FADE_FRAME_INTERVAL * 1000);
+}
+
+// Function to cancel any fade and record the colour about to be written directly (call with fadeLock held)
+static void cancelFade(const RGBColour &colour) {
+  fadeActive = false;
+  fadeLevel[0] = static_cast<uint16_t>(colour.r) << 8;
+  fadeLevel[1] = static_cast<uint16_t>(colour.g) << 8;
+  fadeLevel[2] = static_cast<uint16_t>(colour.b) << 8;
+}
+
+// Function to cancel any fade and show any 24-bit colour straight away
+void showColour(const RGBColour &colour) {
+  esp_timer_stop(fadeTimer); // a frame already running is serialised by fadeLock
+
+  portENTER_CRITICAL(&fadeLock);
+  cancelFade(colour);
+  LEDOutput::writeColour(colour);
+  portEXIT_CRITICAL(&fadeLock);
+  LEDOutput::flush();
+}
+
+// Function to cancel any fade and show a precompiled sequence step straight away
+void showStep(const PackedStep &step) {
+  esp_timer_stop(fadeTimer);
+
+  portENTER_CRITICAL(&fadeLock);
+  cancelFade(step.colour);
+  LEDOutput::writeStep(step);
+  portEXIT_CRITICAL(&fadeLock);
+  LEDOutput::flush();
+}
+
+// Function to read the colour a running fade is showing - returns false (colour untouched) if no fade is running
+bool readFadeColour(RGBColour &colour) {
+  portENTER_CRITICAL(&fadeLock);
+  bool fading = fadeActive;
+  if (fading) {
+    colour = {static_cast<uint8_t>(fadeLevel[0] >> 8), static_cast<uint8_t>(fadeLevel[1] >> 8),
+              static_cast<uint8_t>(fadeLevel[2] >> 8)};
+  }
+  portEXIT_CRITICAL(&fadeLock);
+  return fading;
+}
+
+// Function to check if a fade is running (the display task then keeps the swatch moving)
+bool fadeRunning() {
+  RGBColour unused;
+  return readFadeColour(unused);
+}
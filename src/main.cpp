@@ -6,34 +6,58 @@
  *   It displays operating mode, colour changes, and button presses directly on the built-in screen using
  *    the TFT_eSPI library.
  *   The project demonstrates embedded programming concepts, including:
- *     - Digital Outputs: Controlling the RGB LED by setting the state of GPIO pins.
+ *     - PWM Outputs: Driving the RGB LED with the ESP32-S3 LEDC peripheral (one PWM channel per pin),
+ *        giving full 24-bit colour with no CPU time needed once the duty cycle is set.
  *     - Variables: Storing and manipulating data, such as the current LED colour.
  *     - Enumerations (Enums): Defining named constants for colors and operational modes,
  *        improving code readability.
+ *     - Lookup Tables: Colour sequences (colour, duration, transition) are declared as constexpr tables
+ *        and compiled to LEDC duty values, so changing colour is a single table lookup.
  *     - Functions: Place code into reusable blocks for better organization and modularity.
  *     - State Machines: Implementing different operational modes (automatic or manual colour changes)
  *        based on the program's current state.
- *     - Button Handling: Using the OneButton library to manage button short and long presses for
- *        responsive user interaction.
+ *     - Button Handling: A small gesture engine (clicks, double/triple clicks, long presses and hold-repeat)
+ *        driven by the button interrupt, for responsive user interaction.
+ *     - FreeRTOS Tasks: Button handling and LED control run on the Arduino loop task, while the display
+ *        is drawn by its own task on the other core, so a slow redraw never delays input.
+ *     - Interrupts: Capturing button edges with a GPIO interrupt so the main loop can sleep until
+ *        there is input instead of polling the pin.
+ *     - Event Queue: Button edges, timer ticks and mode/colour changes are timestamped events in a fixed-size
+ *        ring buffer, dispatched in order to the state machine, with one screen update per batch.
+ *     - Low Power: Light sleeping between events (the LED stays lit on LEDC) and dimming, then switching
+ *        off, the backlight when the button hasn't been used for a while.
  *     - TFT_eSPI Library: Utilising the TFT_eSPI graphics library for direct display control.
  *
  * How It Works:
  *   1. RGB LED Control: The code manages an RGB LED, capable of producing Red, Green, Blue, Yellow,
  *       Magenta, Cyan, and White by combining RGB colours.
- *   2. Automatic Mode: The LED cycles through colors automatically, changing every second.
+ *   2. Automatic Mode: The LED cycles through colors automatically, changing every second by default
+ *       (each step can have its own period) on a drift-free esp_timer schedule.
  *   3. Manual Mode: The user can manually change the LED colour with each button press.
- *   4. Button Interaction: The onboard "KEY" button (GPIO14) serves two purposes:
- *      - Short Press: In Manual Mode, a short press cycles the LED to the next colour.
- *      - Long Press (1 second): Switches between Automatic and Manual modes.
- *   5. TFT_eSPI Display: The project utilises the TFT_eSPI library for displaying status,
- *       colour information, and button state directly on the screen.
+ *   4. Fade Mode: Like Automatic Mode, but every step is a gamma-corrected crossfade run from a timer.
+ *   5. Audio Mode (lilygo-t-display-s3-audio build): The colour follows an audio input - bass drives red,
+ *       mids green and treble blue.
+ *   6. Pattern Mode: The colour follows a small bytecode pattern (colours, fades, waits, loops and button
+ *       branches), read from the LittleFS partition or pushed over the network - no reflash needed.
+ *   7. Button Interaction: The onboard "KEY" button (GPIO14) serves several purposes:
+ *      - Short Press: In Manual Mode, a press cycles the LED to the next colour (on press-down).
+ *      - Double Press and Hold: In Manual Mode, scrolls through the colours while the button is held.
+ *      - Double Click: In Automatic and Fade Modes, dims the LED and the screen one brightness step
+ *         (wrapping back to full); a triple click goes straight back to full brightness.
+ *      - Long Press (1 second): Cycles between Automatic, Fade and Manual modes (then Audio, when built in, and
+ *           Pattern, once a pattern is loaded).
+ *           In Manual Mode the press has already stepped the colour on press-down, so the next colour shows while
+ *           the button is held and the previous one comes back when the mode changes.
+ *   8. TFT_eSPI Display: The project utilises the TFT_eSPI library for displaying status,
+ *       colour information, and button state directly on the screen, with a live swatch of the colour on
+ *       the LED (it follows fades) above a hardware-scrolled history of the last 10 colours.
  *
  * Core Concepts and Benefits:
  *   - Helper Functions: Improve code organization, reusability, and maintainability.
  *   - Enums: Enhance code readability by using descriptive names instead of raw numbers.
  *   - State Machines: Simplify the management of different program behaviors and modes.
- *   - OneButton Library: Provides a robust way to handle button presses and long presses without
- *      requiring complex interrupt management.
+ *   - Gesture Engine: Debounces on the leading edge and decides each gesture as early as it can, so a
+ *      press acts within milliseconds of the edge.
  *   - TFT_eSPI: Allows for direct control of the display, enabling direct feedback and state information
  *      without the need of the serial monitor.
  *
@@ -42,17 +66,72 @@
  *   - Green LED      -> GPIO2
  *   - Blue LED       -> GPIO3
  *   - Button         -> GPIO14 (built-in KEY button)
- *   - LCD Backlight  -> GPIO15
+ *   - LCD Backlight  -> GPIO38
+ *   - LCD Power      -> GPIO15
+ *   - LED Strip Data -> GPIO16 (WS2812/SK6812, lilygo-t-display-s3-strip build only)
+ *   - Audio In       -> GPIO10 (microphone module or line input biased to mid-rail, lilygo-t-display-s3-audio
+ *                       build only)
  *   - Ground         -> GND
  *
  * Notes:
- *   - The OneButton library simplifies button handling by debouncing and detecting short and long presses.
+ *   - Button gestures are decided by the gesture engine in the input module (timing in input.h). A press is
+ *      accepted on its first edge and bounce is ignored for 20 ms after it. Clicks only wait out the 300 ms
+ *      multi-click time in the modes that have a double click, so in Manual Mode the colour changes on
+ *      press-down. A long press that leaves Manual Mode puts back the colour that press stepped from.
  *   - The TFT_eSPI library is configured to work with the LilyGO T-Display-S3, providing an easy way to
- *      display information on the built-in screen.
+ *      display information on the built-in screen. The panel setup (ST7789 on the 8-bit parallel bus) is
+ *      pinned in platformio.ini build_flags, and the measured full-screen fill time is printed at boot.
+ *   - Boot is staged for a fast first light: setup() puts the saved colour on the LED and starts the button
+ *      handling within a few milliseconds, then the display task initialises and paints the panel while the
+ *      loop reads the stored pattern from LittleFS on its first pass. The time of each stage is printed over
+ *      serial ("Boot: LED on ... us, input ready ... us, display ready ... us").
  *   - The code uses a state machine to manage the automatic and manual colour change modes, ensuring
  *      clean and maintainable logic.
- *   - Helper functions are moved into a .h file which is then included in main.cpp to make the project
- *      even "cleaner" and easier to maintain.
+ *   - Every mode change, colour change, button edge and command is logged as one 32-bit record in a
+ *      512-entry ring buffer in RTC memory (see telemetry.h). The log survives light sleep and every reset but a
+ *      power-on, and each boot adds a record of the reset reason. An append is two stores with no lock, so it
+ *      stays on in every build. Send "dump" over serial to print the log after a board has misbehaved.
+ *   - A health monitor (see health.h) gives the event dispatch, each LED step and each display frame a deadline
+ *      (10, 5 and 40 ms). It counts the misses, which are in the remote status and the profiling report. Every
+ *      long-running task feeds the ESP task watchdog, so a task stuck for 5 seconds resets the board. If three
+ *      frames in a row overrun, the display drops to plain text fields at 4 frames a second, and goes back to
+ *      full rendering after 20 frames on time.
+ *   - The mode, sequence, colour, brightness, auto period and long press time are saved in NVS
+ *      (Preferences) and restored at boot. Writes are made 3 seconds after the last change, so a burst of
+ *      presses costs one flash write.
+ *   - Patterns (see pattern.h) are checked once when they are loaded. Every operand and jump must be in range,
+ *      and every loop must pass a wait or a fade. They are then decoded into a flat array of 8-byte
+ *      instructions. The interpreter runs on the loop task from an esp_timer tick, on the same drift-free
+ *      schedule as auto mode. It needs no allocation, and one tick is bounded by the pattern's length. Put a
+ *      pattern in data/pattern.bin and upload it with "pio run -t uploadfs", or send it with the remote
+ *      "pattern" command.
+ *   - The lilygo-t-display-s3-audio build adds Audio Mode (see audio.h). The continuous ADC samples GPIO10 at
+ *      20.48 kHz under its own timer, with DMA filling 512-sample frames. An audio task on core 1 runs an ESP-DSP
+ *      FFT on each frame and sums it into three bands, each scaled to its own slowly falling peak. The result
+ *      is crossfaded onto the LED over the 25 ms frame time. Frames the driver had to drop are counted, and
+ *      the remote status reports them.
+ *   - The lilygo-t-display-s3-sync builds keep boards side by side in step (see fleet_sync.h). The one board
+ *      flashed with the -sync-leader build broadcasts a 12-byte ESP-NOW beacon every second, giving its sequence,
+ *      step and the time left in that step. Followers check each beacon against their own schedule on the loop
+ *      task. Small phase errors are slewed out by the scheduler at no more than 2% of a step per step, so there
+ *      is no visible jump. A follower only restarts on the leader's step after a large error or a change of
+ *      sequence.
+ *   - The lilygo-t-display-s3-remote build adds a UDP control surface on port 4210 (see remote_control.h):
+ *      colour, mode, period, sequence, brightness, rotation, whole-sequence uploads, patterns and a status/metrics
+ *      reply, several commands per datagram. It runs on its own task and hands commands to the loop as events.
+ *   - One brightness setting scales both the LED and the backlight in perceived lightness (CIE curve), so
+ *      colours keep their hue as they dim. The LED's level-to-duty table is rebuilt when the brightness changes,
+ *      so every colour write is still a plain lookup.
+ *   - The screen layout is computed once per rotation (portrait or landscape, switched at runtime with the
+ *      remote "rotate" command and saved with the settings). The title and field labels are rasterised once and
+ *      blitted into place, and every other widget redraws only its own bounds.
+ *   - The LED output backend (LEDC PWM, on/off GPIO or an RMT-driven LED strip) is chosen at compile time
+ *      by the PlatformIO environment, with no runtime dispatch.
+ *   - Helper functions are split into led, state, input, display, pattern, telemetry and health modules (a .h in
+ *      include/ and a .cpp in src/ each), pulled into main.cpp through helper_functions.h. The firmware builds with
+ *      -O2 and link-time optimisation, so the small hot-path functions still inline across modules. Run
+ *      "pio run -e lilygo-t-display-s3 -t size_report" before and after a change to compare flash, IRAM and
+ *      DRAM use.
  *********************************************************************************************************/
 
 
@@ -62,12 +141,17 @@
 
 #include <Arduino.h>
 #include <TFT_eSPI.h>
-#include <OneButton.h>
 
 #include "helper_functions.h" // include the helper functions
+#include "remote_control.h"   // Wi-Fi control (compiled out unless ENABLE_REMOTE_CONTROL is set)
+#include "audio.h"            // audio-reactive mode (compiled out unless ENABLE_AUDIO_MODE is set)
+#include "fleet_sync.h"       // ESP-NOW fleet sync (compiled out unless ENABLE_FLEET_SYNC is set)
 
-// OneButton link
-OneButton keyButton(BUTTON_PIN, true); // button object
+// The test suites bring their own setup() and loop() (pio test builds this file too)
+#ifndef PIO_UNIT_TESTING
+
+// Button gestures
+ButtonGestures keyButton; // gesture engine, fed by the button interrupt
 
 // TFT_eSPI
 TFT_eSPI tft = TFT_eSPI();
@@ -79,64 +163,86 @@ TFT_eSPI tft = TFT_eSPI();
 
 // SETUP
 void setup() {
-  // Initialize the RGB LED pins
-  pinMode(RED_PIN, OUTPUT);
-  pinMode(GREEN_PIN, OUTPUT);
-  pinMode(BLUE_PIN, OUTPUT);
+  Serial.begin(115200);
 
-  // Initialise the backlight pin
-  pinMode(PIN_LCD_BL, OUTPUT);
+  // Log the boot into the event log kept in RTC memory (the records from before a crash or reset are kept)
+  startTelemetry();
 
-  // Set the button pin as input with pullup resistor
-  pinMode(BUTTON_PIN, INPUT_PULLUP); // active LOW (HIGH when not pressed)
+  // Reset the board if the loop task stalls (the display task subscribes itself once it is running)
+  startHealthMonitor();
 
-  // Initialize the LED to the starting colour
-  setLEDColour(currentColour);
+  // Restore the mode, sequence, colour and other settings saved in NVS
+  loadSettings();
 
-  // TFT_eSPI setup
-  tft.init();
-  tft.setRotation(0); // adjust rotation (0 & 2 portrait | 1 & 3 landscape)
-  tft.fillScreen(TFT_BLACK);
-  tft.setTextFont(2); // set the font size
-  tft.setTextColor(TFT_WHITE, TFT_BLACK); // set text colour (white) and background colour (black)
+  // Initialize the RGB LED pins as LEDC PWM outputs (or on/off GPIO outputs, see platformio.ini)
+  setupLEDOutput();
+  setupFadeTimer();
 
-  // Draw static elements once
-  drawStaticElements(tft);
+  // Power up the LCD (needed when running from the battery)
+  pinMode(PIN_POWER_ON, OUTPUT);
+  digitalWrite(PIN_POWER_ON, HIGH);
 
-  // Set up button event handlers
-  keyButton.attachClick(onShortPress);
-  keyButton.attachLongPressStart(onLongPressStart);
-  keyButton.setPressMs(1000); // set long press duration in ms
+  // Set the button pin as input with pullup resistor
+  pinMode(BUTTON_PIN, INPUT_PULLUP); // active LOW (HIGH when not pressed)
 
-  redrawDisplay = true; // update screen
+  // Initialize the LED to the starting colour - first light, before anything slow happens
+  applySequenceStep(currentStep);
+  bootLEDTime = esp_timer_get_time();
+
+  // Set up the button gestures for the saved mode (long press duration from the settings, 1000 ms by default)
+  attachGestures(keyButton);
+
+  // Button edges are captured by an interrupt and fed to the gesture engine from the loop
+  setupButtonInterrupt();
+
+  // Auto colour changes and pattern ticks are scheduled by hardware-backed esp_timers
+  setupAutoColourTimer();
+  setupPatternTimer();
+  setMode(currentState); // starts the scheduler or the pattern for the mode, and queues the first screen update
+  settingsDirty = false; // nothing has changed yet
+  bootInputTime = esp_timer_get_time();
+
+  // Hand the display over to its own task on the other core - it initialises the panel, draws the static
+  // layout and then the queued snapshot, while the loop services input
+  startDisplayTask(tft);
+
+  // Read the pattern stored on the LittleFS partition (if one was uploaded) on the first loop pass - mounting the
+  // filesystem can be slow, so it waits until input and the display are under way. A saved pattern mode (which
+  // setMode() above fell back to auto from) resumes once the pattern is loaded
+  postEvent(EventType::LOAD_PATTERN_FILE);
+
+#ifdef ENABLE_AUDIO_MODE
+  // Audio frames are sampled and analysed on their own task and arrive in the loop as events
+  startAudio();
+#endif
+
+#ifdef ENABLE_FLEET_SYNC
+  // The leader's beacons are sent from the esp_timer task, and followers' arrive in the loop as events
+  startFleetSync();
+#endif
+
+#ifdef ENABLE_REMOTE_CONTROL
+  // Network commands are received on their own task and arrive in the loop as events
+  startRemoteControl();
+#endif
 }
 
 // MAIN LOOP
 void loop() {
-  // Keep the button state updated
-  keyButton.tick();
-  bool newButtonState = !digitalRead(BUTTON_PIN);
-
-  if (newButtonState != buttonPressed) {
-    buttonPressed = newButtonState;
-    redrawDisplay = true; // update screen
-  }
-
-  // State machine logic
-  switch (currentState) {
-    case State::Colour_CHANGE_AUTO: // automatic colour change
-      updateAutoColour();
-      break;
-    case State::Colour_CHANGE_MANUAL: // manual colour change with button
-      break;
-    default: // should not happen - reset to default state (Auto Mode)
-      currentState = State::Colour_CHANGE_AUTO;
-      break;
-  }
-
-  // Update the display if something has changed
-  if (redrawDisplay) {
-    updateDynamicElements(tft);
-    redrawDisplay = false; // reset the flag
-  }
+  feedWatchdog(); // the loop is still running (it never idles for longer than HEALTH_FEED_INTERVAL)
+  PROFILE_START(PROFILE_LOOP);
+
+  // Dispatch button edges, auto colour steps and state changes in the order they happened
+  // (the state machine runs in the handlers, and the display gets one snapshot per batch)
+  dispatchEvents(keyButton);
+
+  PROFILE_END(PROFILE_LOOP);
+#ifdef ENABLE_PROFILING
+  serviceProfileReport(); // print the timing probes over serial every few seconds
+#endif
+
+  // Sleep until the next button edge, auto colour change, gesture timer or backlight timeout is due
+  idleUntilNextEvent(keyButton);
 }
+
+#endif // PIO_UNIT_TESTING
@@ -0,0 +1,370 @@
+/*************************************************************
+************************* DEFINITIONS ************************
+**************************************************************/
+
+#include <LittleFS.h>
+#include <atomic>
+
+#include "pattern.h"
+#include "profiling.h" // timing probes (compiled out unless ENABLE_PROFILING is set)
+
+// Patterns
+static Pattern livePattern = {};   // the installed pattern the interpreter runs (loop task only)
+static Pattern stagedPattern = {}; // decoded by the sender, copied out by the loop task
+static portMUX_TYPE patternLock = portMUX_INITIALIZER_UNLOCKED;
+
+// Interpreter state (loop task, apart from the run number the timer callback reads)
+static esp_timer_handle_t patternTimer = nullptr;
+static std::atomic<int32_t> patternRun(0); // bumped on every start and stop, so stale queued ticks are ignored
+static bool patternRunning = false;        // a tick is armed (false once the pattern reaches END)
+static int64_t patternDeadline = 0;        // esp_timer time (us) of the next tick - advanced by each wait
+static uint8_t patternCounter = 0;         // next instruction to run
+
+
+/*************************************************************
+************************** LOADING ***************************
+**************************************************************/
+
+// Function to get the number of operand bytes an opcode takes - -1 for an unknown opcode
+static int patternOperandBytes(uint8_t opcode) {
+  switch (static_cast<PatternOp>(opcode)) {
+    case PatternOp::COLOUR:
+      return 3;
+    case PatternOp::FADE:
+      return 5;
+    case PatternOp::WAIT:
+      return 2;
+    case PatternOp::LOOP:
+      return 2;
+    case PatternOp::BUTTON:
+      return 1;
+    case PatternOp::END:
+      return 0;
+    default:
+      return -1;
+  }
+}
+
+// Function to get the instructions an untimed instruction can go on to within the same tick (index 0, then 1) -
+// -1 when there are no more (WAIT and FADE end the tick, END stops the pattern)
+static int untimedSuccessor(const Pattern &pattern, int instruction, int index) {
+  const PatternInstruction &decoded = pattern.instructions[instruction];
+  int next = (instruction + 1) % pattern.length;
+  switch (decoded.op) {
+    case PatternOp::COLOUR:
+      return index == 0 ? next : -1;
+    case PatternOp::LOOP:
+      if (index == 0) {
+        return decoded.argument;
+      }
+      return (index == 1 && decoded.count > 0) ? next : -1;
+    case PatternOp::BUTTON:
+      if (index == 0) {
+        return decoded.argument;
+      }
+      return index == 1 ? next : -1;
+    default:
+      return -1;
+  }
+}
+
+// Function to check that every cycle of a pattern passes a WAIT or a FADE (a depth-first search over the untimed
+// instructions), so one tick can never run more than the pattern's length of instructions
+static bool patternAlwaysWaits(const Pattern &pattern) {
+  uint8_t visited[PATTERN_MAX_INSTRUCTIONS] = {}; // 0 = not yet, 1 = on the current path, 2 = done
+  uint8_t path[PATTERN_MAX_INSTRUCTIONS];
+  uint8_t edge[PATTERN_MAX_INSTRUCTIONS];
+
+  for (int root = 0; root < pattern.length; root++) {
+    if (visited[root] != 0) {
+      continue;
+    }
+    int depth = 0;
+    path[0] = root;
+    edge[0] = 0;
+    visited[root] = 1;
+
+    while (depth >= 0) {
+      int instruction = path[depth];
+      int next = untimedSuccessor(pattern, instruction, edge[depth]++);
+      if (next < 0) {
+        visited[instruction] = 2;
+        depth--;
+      } else if (visited[next] == 1) {
+        return false; // back on the current path without waiting
+      } else if (visited[next] == 0) {
+        visited[next] = 1;
+        depth++;
+        path[depth] = next;
+        edge[depth] = 0;
+      }
+    }
+  }
+  return true;
+}
+
+// Function to check a bytecode pattern and decode it - returns false (leaving pattern unusable) if it isn't valid
+bool decodePattern(const uint8_t* code, size_t length, Pattern &pattern) {
+  pattern.length = 0;
+  if (length < 3 || length > PATTERN_MAX_BYTES || code[0] != 'P' || code[1] != 'T' || code[2] != PATTERN_VERSION) {
+    return false;
+  }
+
+  int count = 0;
+  for (size_t i = 3; i < length; count++) {
+    int operands = patternOperandBytes(code[i]);
+    if (operands < 0 || count >= PATTERN_MAX_INSTRUCTIONS || i + 1 + operands > length) {
+      return false;
+    }
+
+    const uint8_t* operand = &code[i + 1];
+    PatternInstruction &decoded = pattern.instructions[count];
+    decoded = {static_cast<PatternOp>(code[i]), {0, 0, 0}, 0, 0, 0};
+    switch (decoded.op) {
+      case PatternOp::COLOUR:
+        decoded.colour = {operand[0], operand[1], operand[2]};
+        break;
+      case PatternOp::FADE:
+        decoded.colour = {operand[0], operand[1], operand[2]};
+        decoded.argument = static_cast<uint16_t>(operand[3] | (operand[4] << 8));
+        break;
+      case PatternOp::WAIT:
+        decoded.argument = static_cast<uint16_t>(operand[0] | (operand[1] << 8));
+        break;
+      case PatternOp::LOOP:
+        decoded.argument = operand[0];
+        decoded.count = operand[1];
+        decoded.loopsLeft = operand[1];
+        break;
+      case PatternOp::BUTTON:
+        decoded.argument = operand[0];
+        break;
+      default:
+        break;
+    }
+    i += 1 + operands;
+  }
+  if (count == 0) {
+    return false;
+  }
+
+  // Durations must be set and jumps must land on an instruction
+  for (int i = 0; i < count; i++) {
+    const PatternInstruction &decoded = pattern.instructions[i];
+    bool timed = (decoded.op == PatternOp::FADE || decoded.op == PatternOp::WAIT);
+    bool jump = (decoded.op == PatternOp::LOOP || decoded.op == PatternOp::BUTTON);
+    if ((timed && decoded.argument == 0) || (jump && decoded.argument >= count)) {
+      return false;
+    }
+  }
+
+  pattern.length = static_cast<uint8_t>(count);
+  if (!patternAlwaysWaits(pattern)) {
+    pattern.length = 0;
+    return false;
+  }
+  return true;
+}
+
+// Function to load the pattern stored on the LittleFS partition - returns false if there isn't a valid one
+bool loadPatternFile() {
+  livePattern.length = 0;
+  if (!LittleFS.begin(false)) {
+    return false; // no filesystem has been uploaded
+  }
+
+  File file = LittleFS.open(PATTERN_FILE, "r");
+  if (!file) {
+    return false;
+  }
+  uint8_t code[PATTERN_MAX_BYTES];
+  size_t length = file.size() <= sizeof(code) ? file.read(code, sizeof(code)) : 0;
+  file.close();
+
+  if (!decodePattern(code, length, livePattern)) {
+    Serial.println("Pattern: " PATTERN_FILE " is not a valid pattern");
+    return false;
+  }
+  return true;
+}
+
+// Function to load the stored pattern and resume a saved pattern mode (loop task, on the LOAD_PATTERN_FILE event
+// setup() posts) - mounting the filesystem can be slow, so it waits until the loop is servicing input
+void handlePatternFile() {
+  if (!loadPatternFile() || settings.mode != static_cast<uint8_t>(State::Colour_CHANGE_PATTERN) || settingsDirty) {
+    return; // no pattern, another saved mode (already running), or something has changed since boot
+  }
+  setMode(State::Colour_CHANGE_PATTERN); // setup() fell back to auto mode without the pattern
+  settingsDirty = false;                 // back to the saved mode
+}
+
+// Function to check and stage a pattern to be installed and played by the loop task (safe from another task, one
+// sender at a time) - returns false if it isn't valid
+bool stagePattern(const uint8_t* code, size_t length) {
+  static Pattern decoded; // decoded outside the lock (only the remote task stages patterns)
+  if (!decodePattern(code, length, decoded)) {
+    return false;
+  }
+
+  portENTER_CRITICAL(&patternLock);
+  stagedPattern = decoded;
+  portEXIT_CRITICAL(&patternLock);
+
+  postEvent(EventType::LOAD_PATTERN);
+  return true;
+}
+
+// Function to install the staged pattern and play it
+void installPattern() {
+  portENTER_CRITICAL(&patternLock);
+  bool staged = (stagedPattern.length != 0);
+  if (staged) {
+    livePattern = stagedPattern;
+    stagedPattern.length = 0;
+  }
+  portEXIT_CRITICAL(&patternLock);
+
+  if (!staged) {
+    return;
+  }
+  if (currentState == State::Colour_CHANGE_PATTERN) {
+    startPattern(); // restart on the new pattern
+  } else {
+    setMode(State::Colour_CHANGE_PATTERN);
+  }
+}
+
+// Function to check if there is a pattern to play (safe from any task)
+bool patternLoaded() {
+  portENTER_CRITICAL(&patternLock);
+  bool loaded = (livePattern.length != 0);
+  portEXIT_CRITICAL(&patternLock);
+  return loaded;
+}
+
+
+/*************************************************************
+************************** RUNNING ***************************
+**************************************************************/
+
+// Pattern timer callback (esp_timer task) - hands the tick to the loop task, which owns the LED
+static void onPatternTimer(void* arg) {
+  (void)arg;
+  postEvent(EventType::PATTERN_TICK, patternRun.load());
+}
+
+// Function to create the pattern timer
+void setupPatternTimer() {
+  esp_timer_create_args_t timerArgs = {};
+  timerArgs.callback = onPatternTimer;
+  timerArgs.dispatch_method = ESP_TIMER_TASK;
+  timerArgs.name = "pattern";
+  esp_timer_create(&timerArgs, &patternTimer);
+}
+
+// Function to show a pattern colour - cut to it, or crossfade over durationMs
+static void showPatternColour(const RGBColour &colour, uint32_t durationMs) {
+  if (durationMs > 0 && LEDOutput::canFade) {
+    startFade(colour, durationMs);
+  } else {
+    showColour(colour);
+  }
+  currentRGB = colour;
+  customColour = true;
+  postEvent(EventType::COLOUR_CHANGED, -1); // update screen
+}
+
+// Function to arm the pattern timer waitMs after the previous tick's deadline (so the pattern never drifts)
+static void armPatternTimer(uint32_t waitMs) {
+  patternDeadline += static_cast<int64_t>(waitMs) * 1000;
+  int64_t delay = patternDeadline - esp_timer_get_time();
+  esp_timer_start_once(patternTimer, delay > 0 ? static_cast<uint64_t>(delay) : 0);
+}
+
+// Function to run the pattern up to its next wait and arm the timer for it (validation guarantees one comes within
+// the pattern's length of instructions, unless it reaches END)
+static void runPattern() {
+  for (int executed = 0; executed < livePattern.length; executed++) {
+    PatternInstruction &instruction = livePattern.instructions[patternCounter];
+    uint8_t next = (patternCounter + 1 < livePattern.length) ? patternCounter + 1 : 0;
+
+    switch (instruction.op) {
+      case PatternOp::COLOUR:
+        showPatternColour(instruction.colour, 0);
+        break;
+      case PatternOp::FADE:
+        showPatternColour(instruction.colour, instruction.argument);
+        patternCounter = next;
+        armPatternTimer(instruction.argument); // the next instruction runs once the fade is done
+        return;
+      case PatternOp::WAIT:
+        patternCounter = next;
+        armPatternTimer(instruction.argument);
+        return;
+      case PatternOp::LOOP:
+        if (instruction.count == 0) {
+          next = instruction.argument;
+        } else if (instruction.loopsLeft > 0) {
+          instruction.loopsLeft--;
+          next = instruction.argument;
+        } else {
+          instruction.loopsLeft = instruction.count; // ready for the next time the loop is entered
+        }
+        break;
+      case PatternOp::BUTTON:
+        if (buttonPressed) {
+          next = instruction.argument;
+        }
+        break;
+      case PatternOp::END:
+        patternRunning = false; // the colour stays on
+        return;
+    }
+    patternCounter = next;
+  }
+  patternRunning = false; // can't happen with a validated pattern
+}
+
+// Function to start the pattern from its first instruction
+void startPattern() {
+  esp_timer_stop(patternTimer); // not running is fine
+  patternRun.fetch_add(1);
+  patternRunning = patternLoaded();
+  if (!patternRunning) {
+    return;
+  }
+
+  for (int i = 0; i < livePattern.length; i++) {
+    livePattern.instructions[i].loopsLeft = livePattern.instructions[i].count;
+  }
+  patternCounter = 0;
+  patternDeadline = esp_timer_get_time();
+  runPattern();
+}
+
+// Function to stop the pattern (the LED keeps its colour)
+void stopPattern() {
+  patternRunning = false;
+  esp_timer_stop(patternTimer);
+  patternRun.fetch_add(1);
+}
+
+// Function to get how long (ms) until the next pattern tick - portMAX_DELAY if the pattern isn't running
+uint32_t nextPatternDelay() {
+  if (!patternRunning) {
+    return portMAX_DELAY;
+  }
+  int64_t untilTick = (patternDeadline - esp_timer_get_time()) / 1000;
+  return static_cast<uint32_t>(untilTick > 0 ? untilTick : 0);
+}
+
+// Function to run the pattern on from a tick the timer made due
+void handlePatternTick(const Event &event) {
+  if (event.value != patternRun.load() || !patternRunning) {
+    return; // queued before the pattern was stopped or restarted
+  }
+
+  PROFILE_START(PROFILE_AUTO_COLOUR);
+  runPattern();
+  PROFILE_END(PROFILE_AUTO_COLOUR);
+}
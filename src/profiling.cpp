@@ -0,0 +1,85 @@
+/*************************************************************
+************************* DEFINITIONS ************************
+**************************************************************/
+
+#include "profiling.h"
+#include "health.h"
+
+#ifdef ENABLE_PROFILING
+
+Profile profiles[PROFILE_COUNT] = {
+  {"loop", 0, UINT32_MAX, 0, 0, {}},
+  {"button", 0, UINT32_MAX, 0, 0, {}},
+  {"auto", 0, UINT32_MAX, 0, 0, {}},
+  {"render", 0, UINT32_MAX, 0, 0, {}},
+  {"latency", 0, UINT32_MAX, 0, 0, {}}
+};
+
+
+/*************************************************************
+********************** HELPER FUNCTIONS **********************
+**************************************************************/
+
+// Function to estimate the 99th percentile of a probe in cycles (upper bound of the bucket it falls in)
+uint32_t profilePercentile99(const Profile &profile) {
+  uint32_t target = profile.count - profile.count / 100; // ceil(count * 0.99)
+  uint32_t seen = 0;
+
+  for (int i = 0; i < PROFILE_BUCKETS; i++) {
+    seen += profile.buckets[i];
+    if (seen >= target) {
+      uint32_t bound = profileBucketUpperBound(i);
+      return bound < profile.max ? bound : profile.max;
+    }
+  }
+  return profile.max;
+}
+
+// Function to print every probe over serial, one line each, then the health deadlines:
+// PROFILE <name> count=<n> min=<us> avg=<us> max=<us> p99=<us>
+void reportProfiles() {
+  for (int i = 0; i < PROFILE_COUNT; i++) {
+    const Profile &profile = profiles[i];
+    if (profile.count == 0) {
+      continue;
+    }
+    Serial.printf("PROFILE %s count=%lu min=%lu avg=%lu max=%lu p99=%lu\n", profile.name,
+                  static_cast<unsigned long>(profile.count),
+                  static_cast<unsigned long>(cyclesToMicros(profile.min)),
+                  static_cast<unsigned long>(cyclesToMicros(profile.total / profile.count)),
+                  static_cast<unsigned long>(cyclesToMicros(profile.max)),
+                  static_cast<unsigned long>(cyclesToMicros(profilePercentile99(profile))));
+  }
+  reportHealth();
+}
+
+// Function to print the serial report every PROFILE_REPORT_INTERVAL ms (call from the loop task)
+void serviceProfileReport() {
+  static uint32_t lastReportTime = 0;
+  if (millis() - lastReportTime >= PROFILE_REPORT_INTERVAL) {
+    lastReportTime = millis();
+    reportProfiles();
+  }
+}
+
+// Function to draw the probe statistics in the unused lower part of the screen (call from the display task)
+void drawProfileOverlay(TFT_eSPI &tft, int32_t top) {
+  char line[40];
+
+  tft.setTextColor(TFT_WHITE, TFT_BLACK);
+  for (int i = 0; i < PROFILE_COUNT; i++) {
+    const Profile &profile = profiles[i];
+    uint32_t avg = profile.count ? cyclesToMicros(profile.total / profile.count) : 0;
+    snprintf(line, sizeof(line), "%-7s%6lu%6lu%7lu", profile.name, static_cast<unsigned long>(avg),
+             static_cast<unsigned long>(cyclesToMicros(profilePercentile99(profile))),
+             static_cast<unsigned long>(cyclesToMicros(profile.max)));
+
+    int32_t y = top + (i + 1) * PROFILE_OVERLAY_ROW_HEIGHT;
+    tft.fillRect(0, y, tft.width(), PROFILE_OVERLAY_ROW_HEIGHT, TFT_BLACK);
+    tft.drawString(line, 0, y, 1);
+  }
+  snprintf(line, sizeof(line), "%-7s%6s%6s%7s", "us", "avg", "p99", "max");
+  tft.drawString(line, 0, top, 1);
+}
+
+#endif // ENABLE_PROFILING
@@ -0,0 +1,295 @@
+/*************************************************************
+************************* DEFINITIONS ************************
+**************************************************************/
+
+#include "remote_control.h"
+
+#ifdef ENABLE_REMOTE_CONTROL
+
+#include <WiFi.h>
+#include <esp_system.h>
+#include <lwip/sockets.h>
+
+#include "audio.h"
+#include "display.h"
+#include "fleet_sync.h"
+#include "health.h"
+#include "pattern.h"
+#include "profiling.h"
+#include "telemetry.h"
+
+
+/*************************************************************
+********************** HELPER FUNCTIONS **********************
+**************************************************************/
+
+// Function to parse one upload step ("r,g,b,ms" or "r,g,b,ms,fade") - returns false if it is malformed
+static bool parseUploadStep(const char* text, SequenceStep &step) {
+  unsigned int r, g, b, durationMs;
+  char transition[8] = "";
+
+  int fields = sscanf(text, "%u,%u,%u,%u,%7s", &r, &g, &b, &durationMs, transition);
+  if (fields < 4 || r > 255 || g > 255 || b > 255 || durationMs > UINT16_MAX) {
+    return false;
+  }
+
+  step.colour = {static_cast<uint8_t>(r), static_cast<uint8_t>(g), static_cast<uint8_t>(b)};
+  step.durationMs = static_cast<uint16_t>(durationMs);
+  step.transition = (fields == 5 && strcmp(transition, "fade") == 0) ? Transition::FADE : Transition::CUT;
+  step.name = customColourName;
+  return true;
+}
+
+// Function to parse a run of hex digit pairs (spaces between bytes are allowed) - returns false if it is malformed
+static bool parseHexBytes(const char* text, uint8_t* bytes, size_t size, size_t &length) {
+  length = 0;
+  int high = -1; // first digit of a pair
+  for (; *text != '\0'; text++) {
+    if (*text == ' ' || *text == '\t' || *text == '\r') {
+      continue;
+    }
+    if (!isxdigit(static_cast<unsigned char>(*text))) {
+      return false;
+    }
+
+    int digit = isdigit(static_cast<unsigned char>(*text)) ? *text - '0' : toupper(*text) - 'A' + 10;
+    if (high < 0) {
+      high = digit;
+    } else if (length < size) {
+      bytes[length++] = static_cast<uint8_t>((high << 4) | digit);
+      high = -1;
+    } else {
+      return false;
+    }
+  }
+  return high < 0;
+}
+
+// Function to parse a mode name - returns false if it isn't one
+static bool parseRemoteMode(const char* name, State &mode) {
+  if (strcmp(name, "auto") == 0) {
+    mode = State::Colour_CHANGE_AUTO;
+  } else if (strcmp(name, "fade") == 0) {
+    mode = State::Colour_CHANGE_FADE;
+  } else if (strcmp(name, "manual") == 0) {
+    mode = State::Colour_CHANGE_MANUAL;
+  } else if (strcmp(name, "audio") == 0) {
+    mode = State::Colour_CHANGE_AUDIO;
+  } else if (strcmp(name, "pattern") == 0) {
+    mode = State::Colour_CHANGE_PATTERN;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Function to write the current state and metrics into a reply
+static void formatRemoteStatus(char* reply, size_t size) {
+  DisplayState state;
+  portENTER_CRITICAL(&statusLock);
+  state = latestState;
+  portEXIT_CRITICAL(&statusLock);
+
+  int length = snprintf(reply, size,
+                        "mode=%s colour=%s rgb=%u,%u,%u sequence=%s period=%u brightness=%u rotation=%s uptime_ms=%lu "
+                        "dropped_events=%lu\n",
+                        modeName(state.mode), state.colourName ? state.colourName : "", state.rgb.r, state.rgb.g,
+                        state.rgb.b, state.sequenceName, state.autoPeriodMs, state.brightness,
+                        state.rotation == ROTATION_LANDSCAPE ? "landscape" : "portrait", static_cast<unsigned long>(millis()),
+                        static_cast<unsigned long>(droppedEvents));
+
+  if (length > 0 && static_cast<size_t>(length) < size) {
+    length += snprintf(reply + length, size - length, "telemetry records=%lu reset=%s\n",
+                       static_cast<unsigned long>(telemetryCount()), resetReasonName(esp_reset_reason()));
+  }
+
+  // Deadline misses, one line per deadline
+  for (int i = 0; i < HEALTH_DEADLINE_COUNT && length > 0 && static_cast<size_t>(length) < size; i++) {
+    const HealthMonitor &monitor = healthMonitors[i];
+    length += snprintf(reply + length, size - length, "health %s limit_us=%lu misses=%lu worst_us=%lu%s\n", monitor.name,
+                       static_cast<unsigned long>(monitor.limitUs), static_cast<unsigned long>(monitor.misses.load()),
+                       static_cast<unsigned long>(monitor.worstUs.load()),
+                       (i == HEALTH_FRAME && displayDegraded.load()) ? " degraded" : "");
+  }
+
+#ifdef ENABLE_AUDIO_MODE
+  if (length > 0 && static_cast<size_t>(length) < size) {
+    length += snprintf(reply + length, size - length, "audio frames=%lu overruns=%lu\n",
+                       static_cast<unsigned long>(audioFrames.load()), static_cast<unsigned long>(audioOverruns.load()));
+  }
+#endif
+
+#ifdef ENABLE_FLEET_SYNC
+  if (length > 0 && static_cast<size_t>(length) < size) {
+#ifdef FLEET_SYNC_LEADER
+    const char* role = "leader";
+#else
+    const char* role = "follower";
+#endif
+    length += snprintf(reply + length, size - length, "fleet role=%s beacons=%lu alignments=%lu phase_error_us=%ld\n",
+                       role, static_cast<unsigned long>(fleetBeacons.load()),
+                       static_cast<unsigned long>(fleetAlignments.load()), static_cast<long>(fleetPhaseError.load()));
+  }
+#endif
+
+#ifdef ENABLE_PROFILING
+  // Same figures as the serial report, one line per probe (in us)
+  for (int i = 0; i < PROFILE_COUNT && length > 0 && static_cast<size_t>(length) < size; i++) {
+    const Profile &profile = profiles[i];
+    if (profile.count == 0) {
+      continue;
+    }
+    length += snprintf(reply + length, size - length, "%s count=%lu avg=%lu max=%lu p99=%lu\n", profile.name,
+                       static_cast<unsigned long>(profile.count),
+                       static_cast<unsigned long>(cyclesToMicros(profile.total / profile.count)),
+                       static_cast<unsigned long>(cyclesToMicros(profile.max)),
+                       static_cast<unsigned long>(cyclesToMicros(profilePercentile99(profile))));
+  }
+#else
+  (void)length;
+#endif
+}
+
+// Function to carry out one command - returns false if it isn't understood
+static bool runRemoteCommand(char* command, char* reply, size_t replySize) {
+  char* rest = nullptr;
+  char* name = strtok_r(command, " \t\r", &rest);
+  if (name == nullptr) {
+    return true; // blank line
+  }
+  const char* arguments = rest ? rest : ""; // strtok_r() clears rest at the end of the string
+
+  if (strcmp(name, "colour") == 0 || strcmp(name, "color") == 0) {
+    unsigned int r, g, b;
+    if (sscanf(arguments, "%u %u %u", &r, &g, &b) != 3 || r > 255 || g > 255 || b > 255) {
+      return false;
+    }
+    postEvent(EventType::SET_COLOUR, static_cast<int32_t>((r << 16) | (g << 8) | b));
+  } else if (strcmp(name, "mode") == 0) {
+    char* modeName = strtok_r(nullptr, " \t\r", &rest);
+    State mode;
+    if (modeName == nullptr || !parseRemoteMode(modeName, mode) || !modeAvailable(mode)) {
+      return false; // the loop task would ignore it - an audio-less build, or no pattern loaded yet
+    }
+    postEvent(EventType::SET_MODE, static_cast<int32_t>(mode));
+  } else if (strcmp(name, "period") == 0) {
+    unsigned int periodMs;
+    if (sscanf(arguments, "%u", &periodMs) != 1 || periodMs > UINT16_MAX) {
+      return false;
+    }
+    postEvent(EventType::SET_PERIOD, static_cast<int32_t>(periodMs));
+  } else if (strcmp(name, "sequence") == 0) {
+    int index;
+    if (sscanf(arguments, "%d", &index) != 1 || index < 0 || index >= SEQUENCE_COUNT) {
+      return false;
+    }
+    postEvent(EventType::SET_SEQUENCE, index);
+  } else if (strcmp(name, "rotate") == 0) {
+    char* rotation = strtok_r(nullptr, " \t\r", &rest);
+    if (rotation == nullptr) {
+      return false;
+    } else if (strcmp(rotation, "portrait") == 0) {
+      postEvent(EventType::SET_ROTATION, ROTATION_PORTRAIT);
+    } else if (strcmp(rotation, "landscape") == 0) {
+      postEvent(EventType::SET_ROTATION, ROTATION_LANDSCAPE);
+    } else {
+      return false;
+    }
+  } else if (strcmp(name, "brightness") == 0) {
+    unsigned int brightness;
+    if (sscanf(arguments, "%u", &brightness) != 1 || brightness < BRIGHTNESS_MIN || brightness > 255) {
+      return false;
+    }
+    postEvent(EventType::SET_BRIGHTNESS, static_cast<int32_t>(brightness));
+  } else if (strcmp(name, "upload") == 0) {
+    SequenceStep steps[UPLOAD_MAX_STEPS];
+    int length = 0;
+    for (char* token = strtok_r(nullptr, " \t\r", &rest); token != nullptr; token = strtok_r(nullptr, " \t\r", &rest)) {
+      if (length >= UPLOAD_MAX_STEPS || !parseUploadStep(token, steps[length])) {
+        return false;
+      }
+      length++;
+    }
+    return stageSequenceUpload(steps, length);
+  } else if (strcmp(name, "pattern") == 0) {
+    uint8_t code[PATTERN_MAX_BYTES];
+    size_t length;
+    if (!parseHexBytes(arguments, code, sizeof(code), length)) {
+      return false;
+    }
+    return stagePattern(code, length);
+  } else if (strcmp(name, "status") == 0) {
+    formatRemoteStatus(reply, replySize);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Function to run every command in a datagram in order and build its reply
+static void runRemotePacket(char* packet, char* reply, size_t replySize) {
+  strcpy(reply, "ok\n");
+  char* rest = nullptr;
+
+  for (char* command = strtok_r(packet, "\n;", &rest); command != nullptr; command = strtok_r(nullptr, "\n;", &rest)) {
+    char name[16] = "";
+    sscanf(command, "%15s", name); // runRemoteCommand() tokenises the command in place
+    if (!runRemoteCommand(command, reply, replySize)) {
+      snprintf(reply, replySize, "err %s\n", name);
+      return; // commands after a bad one are skipped, the ones before it have already been posted
+    }
+  }
+}
+
+// Remote control task - joins Wi-Fi, then blocks on the UDP socket and turns each datagram into events
+static void remoteTask(void* parameter) {
+  (void)parameter;
+  static char packet[REMOTE_PACKET_SIZE + 1];
+  static char reply[REMOTE_REPLY_SIZE];
+  watchCurrentTask(); // every wait below is bounded by HEALTH_FEED_INTERVAL
+
+  WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(true);
+  WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+  while (WiFi.status() != WL_CONNECTED) {
+    feedWatchdog();
+    vTaskDelay(pdMS_TO_TICKS(REMOTE_CONNECT_POLL));
+  }
+  Serial.printf("Remote control: udp://%s:%d\n", WiFi.localIP().toString().c_str(), REMOTE_PORT);
+
+  int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(REMOTE_PORT);
+  address.sin_addr.s_addr = htonl(INADDR_ANY); // unicast and broadcast
+  if (sock < 0 || bind(sock, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+    Serial.println("Remote control: could not open the UDP socket");
+    unwatchCurrentTask();
+    vTaskDelete(nullptr);
+    return;
+  }
+  timeval timeout = {HEALTH_FEED_INTERVAL / 1000, (HEALTH_FEED_INTERVAL % 1000) * 1000};
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)); // wake up to feed the watchdog
+
+  for (;;) {
+    feedWatchdog();
+    sockaddr_in sender = {};
+    socklen_t senderLength = sizeof(sender);
+    int length = recvfrom(sock, packet, REMOTE_PACKET_SIZE, 0, reinterpret_cast<sockaddr*>(&sender), &senderLength);
+    if (length <= 0) {
+      continue;
+    }
+
+    packet[length] = '\0';
+    runRemotePacket(packet, reply, sizeof(reply));
+    sendto(sock, reply, strlen(reply), 0, reinterpret_cast<sockaddr*>(&sender), senderLength);
+  }
+}
+
+// Function to start the remote control task (returns straight away - Wi-Fi connects in the background)
+void startRemoteControl() {
+  xTaskCreatePinnedToCore(remoteTask, "remote", REMOTE_TASK_STACK_SIZE, nullptr, REMOTE_TASK_PRIORITY, nullptr,
+                          REMOTE_TASK_CORE);
+}
+
+#endif // ENABLE_REMOTE_CONTROL
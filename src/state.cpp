@@ -0,0 +1,580 @@
+/*************************************************************
+************************* DEFINITIONS ************************
+**************************************************************/
+
+#include "audio.h"     // audio-reactive mode (compiled out unless ENABLE_AUDIO_MODE is set)
+#include "pattern.h"
+#include "profiling.h" // timing probes (compiled out unless ENABLE_PROFILING is set)
+#include "state.h"
+
+// Define global variables (owned by the input/LED task - the display task only sees DisplayState snapshots)
+int currentStep = 0; // step of the active colour sequence shown on the LED (step 0 of the basic palette is RED)
+State currentState = State::Colour_CHANGE_AUTO; // default to Auto Mode
+bool buttonPressed = false;
+
+const Sequence* activeSequence = &sequences[0]; // only changed while the auto colour timer is stopped
+
+// Uploaded sequences (sent as one command, e.g. over the network) - kept in RAM only
+static SequenceStep stagedUpload[UPLOAD_MAX_STEPS]; // written by the sender, copied out by the loop task
+static uint8_t stagedUploadLength = 0;
+static portMUX_TYPE uploadLock = portMUX_INITIALIZER_UNLOCKED;
+static PackedStep uploadedSteps[UPLOAD_MAX_STEPS];  // the installed copy the hot path reads
+Sequence uploadedSequence = {"UPLOAD", uploadedSteps, 0};
+
+const char* const customColourName = CUSTOM_COLOUR_NAME;
+bool customColour = false; // the LED shows a colour set with setLEDRGB() rather than the current step
+
+Settings settings = defaultSettings;
+static Settings storedSettings = {};    // what is in NVS, so unchanged settings are never rewritten
+static Preferences preferences;
+bool settingsDirty = false;             // something changed since the last commit
+static uint32_t settingsChangeTime = 0; // millis() time of the last change
+
+RGBColour currentRGB = basicPaletteSteps[0].colour; // RGB value currently driven on the LED
+
+// Event bus state
+static Event eventQueue[EVENT_QUEUE_SIZE];
+static uint32_t eventHead = 0;                                // next slot to write
+static uint32_t eventTail = 0;                                // next slot to read (loop task only)
+static portMUX_TYPE eventLock = portMUX_INITIALIZER_UNLOCKED; // producers are the GPIO interrupt, the esp_timer task and the loop task
+uint32_t droppedEvents = 0;                                   // events lost because the queue was full
+int64_t dispatchTimeUs = 0;                                   // timestamp of the event being dispatched (0 = none), inherited by the events it causes
+TaskHandle_t loopTaskHandle = nullptr;                        // task woken by the button interrupt and the auto colour timer
+
+// Auto colour scheduler state (each step's period comes from the active sequence)
+static esp_timer_handle_t autoColourTimer = nullptr;
+static std::atomic<bool> autoSchedulerRunning(false);
+static std::atomic<int32_t> autoSchedulerRun(0); // bumped on every start and stop, so steps queued by an earlier run are ignored
+static int64_t nextAutoStepTime = 0;             // esp_timer time (us) of the next step - advanced by the period, never reset to "now"
+static int scheduledAutoStep = 0;                // sequence step the timer is currently counting down
+static const Sequence* scheduledSequence = nullptr; // sequence and period the running schedule was started with
+static uint16_t scheduledPeriodMs = 0;
+static portMUX_TYPE schedulerLock = portMUX_INITIALIZER_UNLOCKED; // the step and its deadline are read by other tasks
+static std::atomic<int32_t> pendingPhaseCorrection(0); // us the schedule still has to move earlier (negative = later)
+
+// Boot stage timestamps (esp_timer time in us since reset), printed once the display is up
+int64_t bootLEDTime = 0;   // restored colour on the LED
+int64_t bootInputTime = 0; // button handling and the auto colour scheduler running
+
+
+/*************************************************************
+************************* EVENT BUS **************************
+**************************************************************/
+
+// Function to add an event to the queue (the caller holds eventLock) - returns false if the queue is full
+static inline bool IRAM_ATTR queueEvent(EventType type, int32_t value, int64_t timeUs) {
+  if (eventHead - eventTail >= EVENT_QUEUE_SIZE) {
+    droppedEvents++;
+    return false;
+  }
+
+  eventQueue[eventHead & (EVENT_QUEUE_SIZE - 1)] = {type, value, timeUs};
+  eventHead++;
+  return true;
+}
+
+// Function to post an event from an interrupt and wake the loop task
+void IRAM_ATTR postEventFromISR(EventType type, int32_t value) {
+  portENTER_CRITICAL_ISR(&eventLock);
+  queueEvent(type, value, esp_timer_get_time());
+  portEXIT_CRITICAL_ISR(&eventLock);
+
+  BaseType_t higherPriorityTaskWoken = pdFALSE;
+  if (loopTaskHandle != nullptr) {
+    vTaskNotifyGiveFromISR(loopTaskHandle, &higherPriorityTaskWoken);
+  }
+  if (higherPriorityTaskWoken) {
+    portYIELD_FROM_ISR();
+  }
+}
+
+// Function to post an event from a task - events caused by the one being dispatched keep its timestamp
+void postEvent(EventType type, int32_t value) {
+  bool fromLoopTask = (loopTaskHandle == nullptr || xTaskGetCurrentTaskHandle() == loopTaskHandle);
+  int64_t timeUs = (fromLoopTask && dispatchTimeUs != 0) ? dispatchTimeUs : esp_timer_get_time();
+
+  portENTER_CRITICAL(&eventLock);
+  queueEvent(type, value, timeUs);
+  portEXIT_CRITICAL(&eventLock);
+
+  if (!fromLoopTask) {
+    xTaskNotifyGive(loopTaskHandle); // the loop task drains the queue itself before it idles again
+  }
+}
+
+// Function to take the oldest event out of the queue - returns false if it is empty
+bool popEvent(Event &event) {
+  portENTER_CRITICAL(&eventLock);
+  bool available = (eventTail != eventHead);
+  if (available) {
+    event = eventQueue[eventTail & (EVENT_QUEUE_SIZE - 1)];
+    eventTail++;
+  }
+  portEXIT_CRITICAL(&eventLock);
+  return available;
+}
+
+// Function to check if any events are waiting to be dispatched
+bool eventsPending() {
+  portENTER_CRITICAL(&eventLock);
+  bool pending = (eventTail != eventHead);
+  portEXIT_CRITICAL(&eventLock);
+  return pending;
+}
+
+/*************************************************************
+************************** SETTINGS **************************
+**************************************************************/
+
+// Function to read the settings back from NVS in one go and apply them (call at boot, before the LED is set)
+void loadSettings() {
+  preferences.begin(SETTINGS_NAMESPACE, false);
+
+  Settings stored;
+  if (preferences.getBytes(SETTINGS_KEY, &stored, sizeof(stored)) == sizeof(stored) && stored.version == SETTINGS_VERSION) {
+    settings = stored;
+    storedSettings = stored;
+  }
+
+  // Anything out of range falls back to the defaults (a mode this build can't enter is caught by setMode())
+  if (settings.mode > static_cast<uint8_t>(State::Colour_CHANGE_PATTERN)) {
+    settings.mode = static_cast<uint8_t>(State::Colour_CHANGE_AUTO);
+  }
+  if (settings.sequence >= SEQUENCE_COUNT) {
+    settings.sequence = 0;
+  }
+  if (settings.step >= sequences[settings.sequence].length) {
+    settings.step = 0;
+  }
+  if (settings.rotation > ROTATION_LANDSCAPE) {
+    settings.rotation = ROTATION_PORTRAIT;
+  }
+  if (settings.longPressMs == 0) {
+    settings.longPressMs = LONG_PRESS_TIME;
+  }
+  if (settings.brightness < BRIGHTNESS_MIN) {
+    settings.brightness = defaultSettings.brightness;
+  }
+
+  currentState = static_cast<State>(settings.mode);
+  activeSequence = &sequences[settings.sequence];
+  currentStep = settings.step;
+  setLEDBrightness(settings.brightness); // before the first colour is written
+}
+
+// Function to note that a setting changed - the write is deferred until changes stop for SETTINGS_COMMIT_DELAY ms
+void markSettingsDirty() {
+  settingsDirty = true;
+  settingsChangeTime = millis();
+}
+
+// Function to write the settings to NVS (skipped if nothing differs from what is already stored)
+void saveSettings() {
+  settings.mode = static_cast<uint8_t>(currentState);
+  settings.sequence = (activeSequence == &uploadedSequence) ? 0 : static_cast<uint8_t>(activeSequence - sequences);
+  settings.step = static_cast<uint8_t>(currentStep);
+  settingsDirty = false;
+
+  if (memcmp(&settings, &storedSettings, sizeof(settings)) != 0) {
+    preferences.putBytes(SETTINGS_KEY, &settings, sizeof(settings));
+    storedSettings = settings;
+  }
+}
+
+// Function to commit settings once they have settled - returns ms until a pending commit is due
+uint32_t serviceSettings() {
+  if (!settingsDirty) {
+    return portMAX_DELAY;
+  }
+
+  uint32_t elapsed = millis() - settingsChangeTime;
+  if (elapsed < SETTINGS_COMMIT_DELAY) {
+    return SETTINGS_COMMIT_DELAY - elapsed;
+  }
+  saveSettings();
+  return portMAX_DELAY;
+}
+
+// Function to get how long a step of the active sequence is shown in auto mode
+uint32_t stepDuration(int step) {
+  return settings.autoPeriodMs ? settings.autoPeriodMs : activeSequence->steps[step].durationMs;
+}
+
+// Function to set the LED to any 24-bit RGB value
+void setLEDRGB(uint8_t r, uint8_t g, uint8_t b) {
+  currentRGB = {r, g, b};
+  customColour = true;
+  showColour(currentRGB);
+
+  postEvent(EventType::COLOUR_CHANGED, -1); // update screen
+}
+
+// Function to show a step of the active sequence - cut straight to its precompiled duty values or crossfade to it
+void applySequenceStep(int step, bool fade) {
+  const PackedStep &packed = activeSequence->steps[step];
+  if (fade && LEDOutput::canFade) {
+    startFade(packed.colour, stepDuration(step));
+  } else {
+    showStep(packed);
+  }
+
+  currentStep = step;
+  currentRGB = packed.colour;
+  customColour = false;
+  postEvent(EventType::COLOUR_CHANGED, step); // update screen
+}
+
+// Function to change the current colour based on the next colour in the sequence.
+void changeColour() {
+  int next = currentStep + 1;
+  if (next >= activeSequence->length) {
+    next = 0;
+  }
+
+  // Fade mode crossfades every step, auto mode follows the sequence, manual presses always cut
+  bool fade = (currentState == State::Colour_CHANGE_FADE) ||
+              (currentState == State::Colour_CHANGE_AUTO && activeSequence->steps[next].transition == Transition::FADE);
+  applySequenceStep(next, fade);
+}
+
+// Function to arm the auto colour timer for the next deadline on the fixed schedule
+static void armAutoColourTimer() {
+  int64_t delay = nextAutoStepTime - esp_timer_get_time();
+  esp_timer_start_once(autoColourTimer, delay > 0 ? static_cast<uint64_t>(delay) : 0);
+}
+
+// Function to take the part of a pending phase correction one step of periodUs may absorb (esp_timer task)
+static int32_t takePhaseCorrection(int64_t periodUs) {
+  int32_t pending = pendingPhaseCorrection.load();
+  if (pending == 0) {
+    return 0;
+  }
+
+  int32_t limit = static_cast<int32_t>(periodUs * AUTO_SLEW_PER_MILLE / 1000);
+  int32_t applied = pending > limit ? limit : (pending < -limit ? -limit : pending);
+  if (!pendingPhaseCorrection.compare_exchange_strong(pending, pending - applied)) {
+    return 0; // a new correction just arrived - it is picked up on the next step
+  }
+  return applied;
+}
+
+// Auto colour timer callback (esp_timer task) - schedules the next step and posts the one that is due. esp_timer_stop()
+// doesn't wait for a callback that is already running, so this only reads the schedule (never activeSequence or the
+// settings the loop task may be changing) and drops its step if the run was stopped or restarted meanwhile
+static void onAutoColourTimer(void* arg) {
+  (void)arg;
+  if (!autoSchedulerRunning.load()) {
+    return; // stopped while this callback was pending
+  }
+
+  portENTER_CRITICAL(&schedulerLock);
+  int32_t run = autoSchedulerRun.load();
+  const Sequence* sequence = scheduledSequence;
+  uint16_t periodMs = scheduledPeriodMs;
+  int next = (scheduledAutoStep + 1) % sequence->length;
+  portEXIT_CRITICAL(&schedulerLock);
+
+  int64_t period = static_cast<int64_t>(periodMs ? periodMs : sequence->steps[next].durationMs) * 1000;
+  int32_t correction = takePhaseCorrection(period);
+
+  portENTER_CRITICAL(&schedulerLock);
+  bool current = (autoSchedulerRun.load() == run);
+  if (current) {
+    scheduledAutoStep = next;
+    nextAutoStepTime += period - correction; // next = previous + period (less any phase correction)
+  }
+  portEXIT_CRITICAL(&schedulerLock);
+  if (!current) {
+    return; // the restarted schedule armed the timer itself
+  }
+  armAutoColourTimer();
+
+  postEvent(EventType::AUTO_STEP, run);
+}
+
+// Function to create the auto colour timer
+void setupAutoColourTimer() {
+  esp_timer_create_args_t timerArgs = {};
+  timerArgs.callback = onAutoColourTimer;
+  timerArgs.dispatch_method = ESP_TIMER_TASK;
+  timerArgs.name = "auto_colour";
+  esp_timer_create(&timerArgs, &autoColourTimer);
+}
+
+// Function to start auto colour changes from the current colour
+void startAutoColour() {
+  startAutoColourAt(currentStep, esp_timer_get_time() + static_cast<int64_t>(stepDuration(currentStep)) * 1000);
+}
+
+// Function to start auto colour changes at a given point of the schedule - step is shown until stepEndUs
+// (esp_timer time), then the sequence carries on from there
+void startAutoColourAt(int step, int64_t stepEndUs) {
+  esp_timer_stop(autoColourTimer); // not running is fine
+  pendingPhaseCorrection.store(0);
+  portENTER_CRITICAL(&schedulerLock);
+  autoSchedulerRun.fetch_add(1); // with the schedule, so a callback reads the run and the schedule it goes with
+  scheduledAutoStep = step;
+  nextAutoStepTime = stepEndUs;
+  scheduledSequence = activeSequence; // published with the step, so readers never pair one sequence with another's step
+  scheduledPeriodMs = settings.autoPeriodMs;
+  portEXIT_CRITICAL(&schedulerLock);
+  autoSchedulerRunning.store(true);
+  armAutoColourTimer();
+}
+
+// Function to stop auto colour changes
+void stopAutoColour() {
+  autoSchedulerRunning.store(false);
+  esp_timer_stop(autoColourTimer);
+  portENTER_CRITICAL(&schedulerLock);
+  autoSchedulerRun.fetch_add(1);
+  portEXIT_CRITICAL(&schedulerLock);
+}
+
+// Function to get how long (ms) until the next auto colour step - portMAX_DELAY if the scheduler isn't running
+uint32_t nextAutoStepDelay() {
+  if (!autoSchedulerRunning.load()) {
+    return portMAX_DELAY;
+  }
+  int64_t untilStep = (nextAutoStepTime - esp_timer_get_time()) / 1000;
+  return static_cast<uint32_t>(untilStep > 0 ? untilStep : 0);
+}
+
+// Function to read where the auto colour schedule is (safe from any task) - returns false if it isn't running
+bool getAutoSchedule(AutoSchedule &schedule) {
+  portENTER_CRITICAL(&schedulerLock);
+  schedule.sequence = scheduledSequence;
+  schedule.periodMs = scheduledPeriodMs;
+  schedule.step = scheduledAutoStep;
+  schedule.stepEndUs = nextAutoStepTime;
+  portEXIT_CRITICAL(&schedulerLock);
+  return autoSchedulerRunning.load();
+}
+
+// Function to move the auto colour schedule earlier by advanceUs (later if negative) - spread over the coming steps,
+// AUTO_SLEW_PER_MILLE of a period at a time (safe from any task, replaces a correction that is still pending)
+void nudgeAutoColour(int32_t advanceUs) {
+  pendingPhaseCorrection.store(advanceUs);
+}
+
+// Function to switch to another sequence, starting from its first step
+void useSequence(const Sequence* sequence) {
+  bool autoRunning = autoSchedulerRunning.load();
+  stopAutoColour(); // the scheduler reads the active sequence
+  activeSequence = sequence;
+  applySequenceStep(0);
+  if (autoRunning) {
+    startAutoColour();
+  }
+  markSettingsDirty();
+}
+
+// Function to switch to another built-in sequence, starting from its first step
+void selectSequence(int index) {
+  if (index < 0 || index >= SEQUENCE_COUNT) {
+    index = 0; // default to the basic palette if an unknown sequence is specified
+  }
+  useSequence(&sequences[index]);
+}
+
+// Function to check if a mode can be entered (audio mode needs its build flag, pattern mode a loaded pattern)
+bool modeAvailable(State mode) {
+  switch (mode) {
+    case State::Colour_CHANGE_AUTO:
+    case State::Colour_CHANGE_MANUAL:
+    case State::Colour_CHANGE_FADE:
+      return true;
+    case State::Colour_CHANGE_AUDIO:
+#ifdef ENABLE_AUDIO_MODE
+      return true;
+#else
+      return false;
+#endif
+    case State::Colour_CHANGE_PATTERN:
+      return patternLoaded();
+    default:
+      return false;
+  }
+}
+
+// Function to switch modes - starts or stops the auto colour scheduler and the pattern to match
+void setMode(State mode) {
+  if (!modeAvailable(mode)) {
+    mode = State::Colour_CHANGE_AUTO; // e.g. pattern mode restored from the settings, but the pattern is gone
+  }
+
+  currentState = mode;
+  if (currentState == State::Colour_CHANGE_AUTO || currentState == State::Colour_CHANGE_FADE) {
+    startAutoColour(); // fade mode uses the same step schedule as auto mode
+  } else {
+    stopAutoColour(); // manual steps come from presses, audio mode's colours from the audio task
+  }
+  if (currentState == State::Colour_CHANGE_PATTERN) {
+    startPattern();
+  } else {
+    stopPattern();
+  }
+#ifdef ENABLE_AUDIO_MODE
+  setAudioSampling(currentState == State::Colour_CHANGE_AUDIO);
+#endif
+  postEvent(EventType::MODE_CHANGED, static_cast<int32_t>(mode)); // update screen
+  markSettingsDirty();
+}
+
+// Function to set the brightness of the LED and the backlight - the LED follows straight away, the backlight when
+// the loop task dispatches the change
+void setBrightness(uint8_t brightness) {
+  brightness = max(brightness, static_cast<uint8_t>(BRIGHTNESS_MIN));
+  if (brightness == settings.brightness) {
+    return;
+  }
+
+  settings.brightness = brightness;
+  setLEDBrightness(brightness);
+  if (!fadeRunning()) {
+    showColour(currentRGB); // a running fade picks the new table up on its next frame
+  }
+  postEvent(EventType::BRIGHTNESS_CHANGED, brightness); // update the backlight
+  markSettingsDirty();
+}
+
+// Function to dim to the next brightness step, wrapping from the dimmest back to full brightness
+void stepBrightness() {
+  setBrightness(settings.brightness > BRIGHTNESS_STEP ? settings.brightness - BRIGHTNESS_STEP : 255);
+}
+
+// Function to apply an auto colour step the timer made due - what a step does depends on the mode
+void handleAutoStep(const Event &event) {
+  if (event.value != autoSchedulerRun.load()) {
+    return; // queued before the scheduler was stopped or restarted
+  }
+
+  PROFILE_START(PROFILE_AUTO_COLOUR);
+  switch (currentState) {
+    case State::Colour_CHANGE_AUTO: // automatic colour change (each step says whether to cut or fade)
+      changeColour();
+      break;
+    case State::Colour_CHANGE_MANUAL: // manual colour change with button - steps only come from presses
+      break;
+    case State::Colour_CHANGE_FADE: // automatic colour change with crossfades (stepped by the fade timer)
+      changeColour();
+      break;
+    case State::Colour_CHANGE_AUDIO: // colours come from the audio task - the scheduler is stopped
+      break;
+    case State::Colour_CHANGE_PATTERN: // colours come from the pattern - the scheduler is stopped
+      break;
+    default: // should not happen - reset to default state (Auto Mode)
+      setMode(State::Colour_CHANGE_AUTO);
+      break;
+  }
+  PROFILE_END(PROFILE_AUTO_COLOUR);
+}
+
+#ifdef ENABLE_AUDIO_MODE
+// Function to show the colour of an audio spectrum frame - crossfaded over one frame, so the LED moves smoothly and
+// the screen's swatch follows it at the display frame rate (frames don't post colour changes or history strips)
+void handleAudioFrame(const Event &event) {
+  if (currentState != State::Colour_CHANGE_AUDIO) {
+    return; // queued before the mode changed
+  }
+
+  RGBColour colour = {static_cast<uint8_t>((event.value >> 16) & 0xFF), static_cast<uint8_t>((event.value >> 8) & 0xFF),
+                      static_cast<uint8_t>(event.value & 0xFF)};
+  if (LEDOutput::canFade) {
+    startFade(colour, AUDIO_FRAME_TIME);
+  } else {
+    showColour(colour);
+  }
+  currentRGB = colour;
+  if (!customColour) {
+    customColour = true;
+    postEvent(EventType::COLOUR_CHANGED, -1); // the Colour field shows CUSTOM while audio mode runs
+  }
+}
+#endif
+
+// Function to stage a sequence to be installed by the loop task (safe from any task) - returns false if it doesn't fit
+bool stageSequenceUpload(const SequenceStep* steps, int length) {
+  if (length <= 0 || length > UPLOAD_MAX_STEPS) {
+    return false;
+  }
+
+  portENTER_CRITICAL(&uploadLock);
+  memcpy(stagedUpload, steps, length * sizeof(SequenceStep));
+  stagedUploadLength = length;
+  portEXIT_CRITICAL(&uploadLock);
+
+  postEvent(EventType::LOAD_SEQUENCE);
+  return true;
+}
+
+// Function to install the staged sequence and play it
+void installUploadedSequence() {
+  SequenceStep steps[UPLOAD_MAX_STEPS];
+  portENTER_CRITICAL(&uploadLock);
+  int length = stagedUploadLength;
+  memcpy(steps, stagedUpload, length * sizeof(SequenceStep));
+  portEXIT_CRITICAL(&uploadLock);
+
+  if (length == 0) {
+    return;
+  }
+
+  bool autoRunning = autoSchedulerRunning.load();
+  stopAutoColour(); // the scheduler may be reading the uploaded steps
+  for (int i = 0; i < length; i++) {
+    uploadedSteps[i] = packStep(steps[i]);
+  }
+  uploadedSequence.length = length;
+  activeSequence = &uploadedSequence;
+  applySequenceStep(0);
+  if (autoRunning) {
+    startAutoColour();
+  }
+}
+
+// Function to carry out a command event (sent from another task, e.g. the network)
+void handleCommand(const Event &event) {
+  switch (event.type) {
+    case EventType::SET_COLOUR:
+      if (currentState != State::Colour_CHANGE_MANUAL) {
+        setMode(State::Colour_CHANGE_MANUAL); // a fixed colour would be replaced by the next auto step
+      }
+      setLEDRGB((event.value >> 16) & 0xFF, (event.value >> 8) & 0xFF, event.value & 0xFF);
+      break;
+    case EventType::SET_MODE:
+      if (event.value >= 0 && event.value <= static_cast<int32_t>(State::Colour_CHANGE_PATTERN) &&
+          modeAvailable(static_cast<State>(event.value))) {
+        setMode(static_cast<State>(event.value));
+      }
+      break;
+    case EventType::SET_PERIOD:
+      settings.autoPeriodMs = static_cast<uint16_t>(constrain(event.value, 0, UINT16_MAX));
+      if (autoSchedulerRunning.load()) {
+        startAutoColour(); // re-arm from now with the new period
+      }
+      markSettingsDirty();
+      break;
+    case EventType::SET_SEQUENCE:
+      selectSequence(event.value);
+      break;
+    case EventType::SET_ROTATION:
+      if ((event.value == ROTATION_PORTRAIT || event.value == ROTATION_LANDSCAPE) && event.value != settings.rotation) {
+        settings.rotation = static_cast<uint8_t>(event.value);
+        postEvent(EventType::ROTATION_CHANGED, event.value); // the display task re-lays the screen out
+        markSettingsDirty();
+      }
+      break;
+    case EventType::SET_BRIGHTNESS:
+      setBrightness(static_cast<uint8_t>(constrain(event.value, BRIGHTNESS_MIN, 255)));
+      break;
+    case EventType::LOAD_SEQUENCE:
+      installUploadedSequence();
+      break;
+    case EventType::LOAD_PATTERN:
+      installPattern();
+      break;
+    default:
+      break;
+  }
+}
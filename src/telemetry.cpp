@@ -0,0 +1,167 @@
+/*************************************************************
+************************* DEFINITIONS ************************
+**************************************************************/
+
+#include <esp_system.h>
+
+#include "health.h"
+#include "telemetry.h"
+
+// The log - RTC_NOINIT_ATTR keeps it out of the startup code's zeroing, so it outlives every reset but a power-on
+RTC_NOINIT_ATTR TelemetryLog telemetryLog;
+
+
+/*************************************************************
+********************** HELPER FUNCTIONS **********************
+**************************************************************/
+
+// Function to get a readable name for a reset reason
+const char* resetReasonName(int reason) {
+  switch (static_cast<esp_reset_reason_t>(reason)) {
+    case ESP_RST_POWERON:
+      return "power-on";
+    case ESP_RST_EXT:
+      return "external";
+    case ESP_RST_SW:
+      return "software";
+    case ESP_RST_PANIC:
+      return "panic";
+    case ESP_RST_INT_WDT:
+      return "interrupt-watchdog";
+    case ESP_RST_TASK_WDT:
+      return "task-watchdog";
+    case ESP_RST_WDT:
+      return "watchdog";
+    case ESP_RST_DEEPSLEEP:
+      return "deep-sleep";
+    case ESP_RST_BROWNOUT:
+      return "brownout";
+    case ESP_RST_SDIO:
+      return "sdio";
+    default:
+      return "unknown";
+  }
+}
+
+// Function to get the name of a record type
+static const char* telemetryTypeName(uint8_t type) {
+  if (type == TELEMETRY_BOOT) {
+    return "BOOT";
+  }
+  switch (static_cast<EventType>(type)) {
+    case EventType::BUTTON_EDGE:
+      return "BUTTON_EDGE";
+    case EventType::AUTO_STEP:
+      return "AUTO_STEP";
+    case EventType::MODE_CHANGED:
+      return "MODE_CHANGED";
+    case EventType::COLOUR_CHANGED:
+      return "COLOUR_CHANGED";
+    case EventType::BUTTON_CHANGED:
+      return "BUTTON_CHANGED";
+    case EventType::ROTATION_CHANGED:
+      return "ROTATION_CHANGED";
+    case EventType::BRIGHTNESS_CHANGED:
+      return "BRIGHTNESS_CHANGED";
+    case EventType::AUDIO_FRAME:
+      return "AUDIO_FRAME";
+    case EventType::FLEET_BEACON:
+      return "FLEET_BEACON";
+    case EventType::PATTERN_TICK:
+      return "PATTERN_TICK";
+    case EventType::SET_COLOUR:
+      return "SET_COLOUR";
+    case EventType::SET_MODE:
+      return "SET_MODE";
+    case EventType::SET_PERIOD:
+      return "SET_PERIOD";
+    case EventType::SET_SEQUENCE:
+      return "SET_SEQUENCE";
+    case EventType::SET_ROTATION:
+      return "SET_ROTATION";
+    case EventType::SET_BRIGHTNESS:
+      return "SET_BRIGHTNESS";
+    case EventType::LOAD_SEQUENCE:
+      return "LOAD_SEQUENCE";
+    case EventType::LOAD_PATTERN:
+      return "LOAD_PATTERN";
+    case EventType::LOAD_PATTERN_FILE:
+      return "LOAD_PATTERN_FILE";
+  }
+  return "?";
+}
+
+// Function to get how many records the log holds
+uint32_t telemetryCount() {
+  uint32_t head = telemetryLog.head;
+  return head < TELEMETRY_SIZE ? head : TELEMETRY_SIZE;
+}
+
+// Function to get one record of the log (0 = the oldest)
+uint32_t telemetryRecord(uint32_t index) {
+  uint32_t head = telemetryLog.head;
+  uint32_t oldest = head - telemetryCount();
+  return telemetryLog.records[(oldest + index) & (TELEMETRY_SIZE - 1)];
+}
+
+// Function to print the log over serial, oldest record first
+// (from the console task - records the loop task appends meanwhile may replace the oldest ones)
+void dumpTelemetry() {
+  uint32_t count = telemetryCount();
+  Serial.printf("Telemetry: %lu records, oldest first\n", static_cast<unsigned long>(count));
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t record = telemetryRecord(i);
+    uint8_t type = telemetryType(record);
+    if (type == TELEMETRY_BOOT) {
+      Serial.printf("LOG %lu t_ms=%lu BOOT reset=%s\n", static_cast<unsigned long>(i),
+                    static_cast<unsigned long>(telemetryTimeMs(record)), resetReasonName(telemetryValue(record)));
+    } else {
+      Serial.printf("LOG %lu t_ms=%lu %s value=%u\n", static_cast<unsigned long>(i),
+                    static_cast<unsigned long>(telemetryTimeMs(record)), telemetryTypeName(type), telemetryValue(record));
+    }
+  }
+}
+
+// Serial console task - reads commands a line at a time ("dump" is the only one)
+static void telemetryConsoleTask(void* parameter) {
+  (void)parameter;
+  char line[16];
+  size_t length = 0;
+  watchCurrentTask();
+
+  for (;;) {
+    feedWatchdog();
+    while (Serial.available() > 0) {
+      int c = Serial.read();
+      if (c == '\n' || c == '\r') {
+        line[length] = '\0';
+        if (strcmp(line, "dump") == 0) {
+          dumpTelemetry();
+        }
+        length = 0;
+      } else if (length < sizeof(line) - 1) {
+        line[length++] = static_cast<char>(c);
+      }
+    }
+    vTaskDelay(pdMS_TO_TICKS(TELEMETRY_CONSOLE_POLL));
+  }
+}
+
+// Function to check the log kept from before the reset (starting afresh after a power-on), log the boot and start
+// the serial console (call first thing in setup())
+void startTelemetry() {
+  esp_reset_reason_t reason = esp_reset_reason();
+  if (telemetryLog.magic != TELEMETRY_MAGIC || reason == ESP_RST_POWERON) {
+    memset(telemetryLog.records, 0, sizeof(telemetryLog.records)); // RTC memory powers up with random contents
+    telemetryLog.head = 0;
+    telemetryLog.magic = TELEMETRY_MAGIC;
+  }
+
+  uint32_t kept = telemetryCount();
+  logTelemetry(TELEMETRY_BOOT, static_cast<uint8_t>(reason), esp_timer_get_time());
+  Serial.printf("Telemetry: reset=%s, %lu records kept (send \"dump\" to print them)\n", resetReasonName(reason),
+                static_cast<unsigned long>(kept));
+
+  xTaskCreatePinnedToCore(telemetryConsoleTask, "console", TELEMETRY_CONSOLE_STACK_SIZE, nullptr,
+                          TELEMETRY_CONSOLE_PRIORITY, nullptr, TELEMETRY_CONSOLE_CORE);
+}
@@ -0,0 +1,251 @@
+/*********************************************************************************************************
+ * LILYGO T-Display-S3 3-Colour LED Project - On-device benchmarks
+ *
+ * Description:
+ *   Unity test suite that times the hot paths of the firmware on the real board:
+ *     - LED colour change: digitalWrite vs direct GPIO register writes vs LEDC duty writes
+ *     - updateDynamicElements: full redraw (every field dirty) vs partial redraw (one field dirty)
+ *     - drawStaticElements
+ *     - Button edge to interrupt, and edge to gesture press callback
+ *     - Telemetry: appending one record to the RTC memory event log
+ *
+ * Running:
+ *   pio test -e bench
+ *   Nothing may be pressed while the suite runs - the button test drives GPIO14 low itself.
+ *
+ * Output:
+ *   One line per measurement, easy to grep out of the serial log:
+ *     BENCH <name> iterations=<n> total_us=<us> per_op_ns=<ns>
+ *********************************************************************************************************/
+
+
+/*************************************************************
+******************* INCLUDES & DEFINITIONS *******************
+**************************************************************/
+
+#include <Arduino.h>
+#include <TFT_eSPI.h>
+#include <unity.h>
+#include <soc/gpio_reg.h>
+
+#include "helper_functions.h"
+
+#define LED_ITERATIONS 10000    // colour changes per LED benchmark
+#define REDRAW_ITERATIONS 100   // redraws per display benchmark
+#define STATIC_ITERATIONS 10    // static layout redraws
+#define BUTTON_ITERATIONS 10    // simulated button presses
+#define BUTTON_TIMEOUT_US 500000 // give up on a press callback after this long
+#define BUTTON_LATENCY_LIMIT_US 5000 // edge to press callback target (gestures fire on press-down)
+#define TELEMETRY_ITERATIONS 10000   // records appended (the log wraps many times over)
+
+ButtonGestures keyButton;
+TFT_eSPI tft = TFT_eSPI();
+
+// Time (micros) the simulated press callback fired
+volatile uint32_t pressCallbackTime = 0;
+
+
+/*************************************************************
+********************** HELPER FUNCTIONS **********************
+**************************************************************/
+
+// Function to print one result in the BENCH line format
+void reportBench(const char* name, uint32_t iterations, uint32_t totalUs) {
+  uint32_t perOpNs = static_cast<uint32_t>((static_cast<uint64_t>(totalUs) * 1000) / iterations);
+  Serial.printf("BENCH %s iterations=%lu total_us=%lu per_op_ns=%lu\n", name,
+                static_cast<unsigned long>(iterations), static_cast<unsigned long>(totalUs),
+                static_cast<unsigned long>(perOpNs));
+}
+
+// Function to set the LED the way the original firmware did (three digitalWrite calls)
+void setLEDDigitalWrite(const RGBColour &colour) {
+  digitalWrite(RED_PIN, colour.r ? HIGH : LOW);
+  digitalWrite(GREEN_PIN, colour.g ? HIGH : LOW);
+  digitalWrite(BLUE_PIN, colour.b ? HIGH : LOW);
+}
+
+// Function to build a DisplayState snapshot for the display benchmarks
+DisplayState benchDisplayState(bool pressed) {
+  DisplayState state = {State::Colour_CHANGE_MANUAL, basicPalette.steps[0].name, basicPalette.steps[0].colour, pressed,
+                        ROTATION_PORTRAIT, esp_timer_get_time(), "BASIC", 0, 255};
+  return state;
+}
+
+void onBenchPress(uint8_t count) {
+  (void)count;
+  pressCallbackTime = micros();
+}
+
+
+/*************************************************************
+************************* BENCHMARKS *************************
+**************************************************************/
+
+void test_led_digitalwrite() {
+  pinMode(RED_PIN, OUTPUT);
+  pinMode(GREEN_PIN, OUTPUT);
+  pinMode(BLUE_PIN, OUTPUT);
+
+  uint32_t startTime = micros();
+  for (int i = 0; i < LED_ITERATIONS; i++) {
+    setLEDDigitalWrite(basicPalette.steps[i % 7].colour);
+  }
+  reportBench("led_digitalwrite", LED_ITERATIONS, micros() - startTime);
+}
+
+void test_led_gpio_register() {
+  // Precompute a set and clear mask per colour, then change all three pins with two register writes
+  uint32_t setMasks[7];
+  uint32_t clearMasks[7];
+  const uint32_t allPins = (1UL << RED_PIN) | (1UL << GREEN_PIN) | (1UL << BLUE_PIN);
+  for (int i = 0; i < 7; i++) {
+    const RGBColour &colour = basicPalette.steps[i].colour;
+    setMasks[i] = (colour.r ? 1UL << RED_PIN : 0) | (colour.g ? 1UL << GREEN_PIN : 0) | (colour.b ? 1UL << BLUE_PIN : 0);
+    clearMasks[i] = allPins & ~setMasks[i];
+  }
+
+  uint32_t startTime = micros();
+  for (int i = 0; i < LED_ITERATIONS; i++) {
+    REG_WRITE(GPIO_OUT_W1TS_REG, setMasks[i % 7]);
+    REG_WRITE(GPIO_OUT_W1TC_REG, clearMasks[i % 7]);
+  }
+  reportBench("led_gpio_register", LED_ITERATIONS, micros() - startTime);
+}
+
+void test_led_ledc() {
+  setupPWMTimer(); // moves the pins over to LEDC
+  LEDCOutput::begin();
+
+  uint32_t startTime = micros();
+  for (int i = 0; i < LED_ITERATIONS; i++) {
+    LEDCOutput::writeStep(basicPalette.steps[i % 7]);
+  }
+  reportBench("led_ledc", LED_ITERATIONS, micros() - startTime);
+}
+
+void test_redraw_full_vs_partial() {
+  bool pressed = false;
+
+  uint32_t startTime = micros();
+  for (int i = 0; i < REDRAW_ITERATIONS; i++) {
+    invalidateDynamicElements(); // every field dirty
+    updateDynamicElements(tft, benchDisplayState(pressed));
+  }
+  uint32_t fullTime = micros() - startTime;
+  reportBench("redraw_full", REDRAW_ITERATIONS, fullTime);
+
+  startTime = micros();
+  for (int i = 0; i < REDRAW_ITERATIONS; i++) {
+    pressed = !pressed; // only the Button field changes
+    updateDynamicElements(tft, benchDisplayState(pressed));
+  }
+  uint32_t partialTime = micros() - startTime;
+  reportBench("redraw_partial", REDRAW_ITERATIONS, partialTime);
+
+#ifndef USE_SPRITE_RENDERER // the sprite renderer always pushes the whole area
+  TEST_ASSERT_LESS_THAN_UINT32(fullTime, partialTime);
+#endif
+}
+
+void test_draw_static_elements() {
+  uint32_t startTime = micros();
+  for (int i = 0; i < STATIC_ITERATIONS; i++) {
+    drawStaticElements(tft);
+  }
+  reportBench("draw_static", STATIC_ITERATIONS, micros() - startTime);
+}
+
+void test_button_edge_latency() {
+  keyButton.attach(Gesture::PRESS, onBenchPress); // fires as soon as the gesture engine accepts the press
+  setupButtonInterrupt();
+
+  uint32_t isrTotal = 0;
+  uint32_t callbackTotal = 0;
+  int completed = 0;
+
+  for (int i = 0; i < BUTTON_ITERATIONS; i++) {
+    pressCallbackTime = 0;
+
+    // Drive the pin low from the output side to produce a real GPIO edge
+    gpio_set_direction(static_cast<gpio_num_t>(BUTTON_PIN), GPIO_MODE_INPUT_OUTPUT);
+    uint32_t edgeTime = micros();
+    gpio_set_level(static_cast<gpio_num_t>(BUTTON_PIN), 0);
+
+    while (pressCallbackTime == 0 && micros() - edgeTime < BUTTON_TIMEOUT_US) {
+      dispatchEvents(keyButton); // spin instead of idling so the callback time is as tight as possible
+    }
+
+    if (pressCallbackTime != 0) {
+      isrTotal += lastButtonPressUs - edgeTime;
+      callbackTotal += pressCallbackTime - edgeTime;
+      completed++;
+    }
+
+    // Release and let the gesture engine settle before the next press
+    gpio_set_level(static_cast<gpio_num_t>(BUTTON_PIN), 1);
+    gpio_set_direction(static_cast<gpio_num_t>(BUTTON_PIN), GPIO_MODE_INPUT);
+    uint32_t releaseTime = millis();
+    while (millis() - releaseTime < 1000) {
+      dispatchEvents(keyButton);
+      delay(BUTTON_TICK_INTERVAL);
+    }
+    lastButtonPressUs = 0;
+  }
+
+  TEST_ASSERT_EQUAL_INT(BUTTON_ITERATIONS, completed);
+  reportBench("button_edge_to_isr", completed, isrTotal);
+  reportBench("button_edge_to_callback", completed, callbackTotal);
+  TEST_ASSERT_LESS_THAN_UINT32(BUTTON_LATENCY_LIMIT_US * completed, callbackTotal);
+}
+
+void test_telemetry_append() {
+  Event event = {EventType::COLOUR_CHANGED, 0, 0};
+  uint32_t headBefore = telemetryLog.head;
+
+  uint32_t startTime = micros();
+  for (int i = 0; i < TELEMETRY_ITERATIONS; i++) {
+    event.value = i;
+    event.timeUs = i;
+    logTelemetryEvent(event);
+  }
+  reportBench("telemetry_append", TELEMETRY_ITERATIONS, micros() - startTime);
+  TEST_ASSERT_EQUAL_UINT32(headBefore + TELEMETRY_ITERATIONS, telemetryLog.head);
+}
+
+
+/*************************************************************
+*********************** MAIN FUNCTIONS ***********************
+**************************************************************/
+
+void setUp() {}
+
+void tearDown() {}
+
+// SETUP
+void setup() {
+  Serial.begin(115200);
+  delay(2000); // wait for the serial monitor
+
+  pinMode(PIN_POWER_ON, OUTPUT);
+  digitalWrite(PIN_POWER_ON, HIGH);
+  tft.init();
+  tft.setRotation(0);
+  tft.fillScreen(TFT_BLACK);
+  setupRenderer(tft);
+  buildStaticLayer(tft);
+  buildLabelCache(tft);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_led_digitalwrite);
+  RUN_TEST(test_led_gpio_register);
+  RUN_TEST(test_led_ledc);
+  RUN_TEST(test_redraw_full_vs_partial);
+  RUN_TEST(test_draw_static_elements);
+  RUN_TEST(test_button_edge_latency);
+  RUN_TEST(test_telemetry_append);
+  UNITY_END();
+}
+
+// MAIN LOOP
+void loop() {
+}
@@ -0,0 +1,614 @@
+/*********************************************************************************************************
+ * LILYGO T-Display-S3 3-Colour LED Project - Host simulation
+ *
+ * Description:
+ *   Unity test suite that runs the firmware's state machine, sequencer and renderer on the host, against the
+ *    mocked board in lib/native_hal on a virtual clock - hours of auto mode take milliseconds. Each scenario
+ *    counts the display operations and pixels it generates, so a redraw-efficiency regression fails here
+ *    before it reaches the board:
+ *     - Boot: first light, the static layout and the first snapshot
+ *     - Auto mode for hours: drift-free steps, and exactly one label, strip, scroll and swatch per step
+ *     - Fade mode: the swatch follows the fade at the display frame rate
+ *     - Manual presses: only the fields that changed are redrawn, and a burst of presses is one flash write
+ *     - Rotation: switching between portrait and landscape blits the static layer instead of repainting the screen
+ *     - Phase nudge: a fleet sync correction is slewed into the auto schedule a little per step, never lost
+ *     - Pattern: bytecode is validated on load, runs on a drift-free schedule from LittleFS, and follows the button
+ *     - Telemetry: events are logged as they are dispatched, and the log outlives every reset but a power-on
+ *     - Health: a display that keeps overrunning falls back to text-only rendering, and recovers once on time
+ *
+ * Running:
+ *   pio test -e native
+ *
+ * Output:
+ *   One line per scenario, alongside the assertions:
+ *     SIM <name> simulated_s=<s> wall_ms=<ms> operations=<n> pixels=<n> fills=<n> images=<n> text=<n>
+ *      commands=<n> sleep_pct=<%>
+ *********************************************************************************************************/
+
+
+/*************************************************************
+******************* INCLUDES & DEFINITIONS *******************
+**************************************************************/
+
+#include <chrono>
+
+#include <esp_system.h>
+
+#include <Arduino.h>
+#include <TFT_eSPI.h>
+#include <unity.h>
+#include <native_hal.h>
+
+#include "helper_functions.h"
+
+#define SIM_AUTO_HOURS 4        // simulated time of the auto mode scenario
+#define SIM_FADE_TIME 60000     // simulated time of the fade mode scenario in ms
+#define SIM_PRESS_COUNT 20      // short presses in the manual scenario
+#define SIM_PRESS_HOLD 100      // ms a short press is held
+#define SIM_PRESS_SPACING 800   // ms between short presses (more than the multi-click time)
+#define SIM_LONG_PRESS_HOLD 1200
+#define SIM_CLICK_GAP 100       // ms between the two presses of a double click
+#define SIM_PRESS_LATENCY 5     // ms a manual press may take to change the colour
+#define SIM_REPEAT_HOLD 1000    // ms the second press of a double press is held to scroll the colours
+#define SIM_PHASE_NUDGE 100     // ms the auto schedule is nudged earlier in the phase lock scenario
+#define SIM_PATTERN_TIME 600000 // simulated time of the pattern scenario in ms
+#define SIM_PATTERN_HOLD 300    // ms the button is held (and then released) to take the pattern's button branch
+#define SIM_TELEMETRY_STEPS 600 // auto colour steps in the telemetry scenario (more than the log holds)
+
+// Panel traffic of one redraw of the dynamic fields - the sprite renderer always pushes the whole area in one image
+#ifdef USE_SPRITE_RENDERER
+#define REDRAW_IMAGES(fields) 1
+#define REDRAW_PIXELS(fields) (layout.dynamicArea.w * layout.dynamicArea.h)
+#else
+#define REDRAW_IMAGES(fields) (fields)
+#define REDRAW_PIXELS(fields) ((fields) * FIELD_WIDTH * FIELD_HEIGHT)
+#endif
+
+// Pixels one colour step puts on the panel: the Colour field, a history strip and the swatch
+#define STEP_PIXELS (REDRAW_PIXELS(1) + TFT_WIDTH * HISTORY_STRIP_HEIGHT + TFT_WIDTH * SWATCH_HEIGHT)
+
+ButtonGestures keyButton;
+TFT_eSPI tft = TFT_eSPI();
+
+// Display task state (the display task's loop body is run by serviceDisplay())
+DisplayState shownState;
+bool shownStateReceived = false;
+bool waitingForFrame = false; // the display task is waiting SWATCH_FRAME_INTERVAL for a fade frame
+int64_t lastFrameUs = 0;
+
+// Start of the measured part of the current scenario
+int64_t measureStartUs = 0;
+int64_t measureSleepStartUs = 0;
+std::chrono::steady_clock::time_point measureWallStart;
+
+
+/*************************************************************
+********************** HELPER FUNCTIONS **********************
+**************************************************************/
+
+// Function to power the board up (or reset it for another reason) and run setup() the way src/main.cpp does, then
+// the display task's init
+void bootFirmware(esp_reset_reason_t reason = ESP_RST_POWERON) {
+  halReset();
+  halSetResetReason(reason);
+  settings = defaultSettings; // what loadSettings() falls back to on an empty NVS
+  historyHead = 0;
+  historyCount = 0;
+  buttonPressed = false;
+  keyButton.reset();
+  Event stale;
+  while (popEvent(stale)) {
+  }
+
+  startTelemetry();
+  startHealthMonitor();
+  loadSettings();
+  setupLEDOutput();
+  setupFadeTimer();
+  pinMode(PIN_POWER_ON, OUTPUT);
+  digitalWrite(PIN_POWER_ON, HIGH);
+  pinMode(BUTTON_PIN, INPUT_PULLUP);
+  applySequenceStep(currentStep);
+  attachGestures(keyButton);
+  setupButtonInterrupt();
+  setupAutoColourTimer();
+  setupPatternTimer();
+  setMode(currentState);
+  settingsDirty = false;
+  startDisplayTask(tft); // creates the mailbox - the task itself is run by serviceDisplay()
+  postEvent(EventType::LOAD_PATTERN_FILE);
+
+  initDisplay(tft);
+  shownStateReceived = false;
+  waitingForFrame = false;
+  lastFrameUs = halNowUs();
+}
+
+// Function to do the display task's work for one wake-up: render a new snapshot, or a fade frame once one is due
+void serviceDisplay() {
+  if (xQueueReceive(displayQueue, &shownState, 0) == pdTRUE) {
+    shownStateReceived = true;
+    renderDisplayState(tft, shownState);
+    lastFrameUs = halNowUs();
+  } else if (shownStateReceived && waitingForFrame && halNowUs() - lastFrameUs >= SWATCH_FRAME_INTERVAL * 1000) {
+    updateColourPreview(tft, shownState);
+    lastFrameUs = halNowUs();
+  }
+  waitingForFrame = fadeRunning();
+}
+
+// Function to run the firmware for a while - loop() on the loop task, then the display task, until the time is up
+void runFor(uint32_t ms) {
+  int64_t endUs = halNowUs() + static_cast<int64_t>(ms) * 1000;
+
+  while (halNowUs() < endUs) {
+    dispatchEvents(keyButton);
+    serviceDisplay();
+
+    // Blocking waits stop where the display task would next wake up
+    int64_t horizonUs = endUs;
+    if (waitingForFrame) {
+      horizonUs = min<int64_t>(horizonUs, lastFrameUs + SWATCH_FRAME_INTERVAL * 1000);
+    }
+    halSetHorizonUs(horizonUs);
+    idleUntilNextEvent(keyButton);
+  }
+  dispatchEvents(keyButton);
+  serviceDisplay();
+}
+
+// Function to hold the button down for a while and release it, running the firmware throughout
+void pressButton(uint32_t holdMs, uint32_t afterMs) {
+  halSchedulePin(BUTTON_PIN, LOW, halNowUs());
+  halSchedulePin(BUTTON_PIN, HIGH, halNowUs() + static_cast<int64_t>(holdMs) * 1000);
+  runFor(holdMs + afterMs);
+}
+
+// Function to start measuring a scenario from now (display traffic, time asleep and wall time)
+void startMeasuring() {
+  halResetDisplayStats();
+  measureStartUs = halNowUs();
+  measureSleepStartUs = halSleepTimeUs();
+  measureWallStart = std::chrono::steady_clock::now();
+}
+
+// Function to get the simulated time (us) since startMeasuring()
+int64_t measuredTimeUs() {
+  return halNowUs() - measureStartUs;
+}
+
+// Function to print the measured part of a scenario in the SIM line format
+void reportScenario(const char* name) {
+  const DisplayStats &stats = halDisplayStats();
+  int64_t simulatedUs = measuredTimeUs();
+  double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - measureWallStart).count();
+  int64_t sleptUs = halSleepTimeUs() - measureSleepStartUs;
+  unsigned sleepPercent = simulatedUs > 0 ? static_cast<unsigned>(sleptUs * 100 / simulatedUs) : 0;
+
+  printf("SIM %s simulated_s=%lld wall_ms=%.1f operations=%lu pixels=%llu fills=%lu images=%lu text=%lu commands=%lu "
+         "sleep_pct=%u\n",
+         name, static_cast<long long>(simulatedUs / 1000000), wallMs, static_cast<unsigned long>(stats.operations()),
+         static_cast<unsigned long long>(stats.pixels), static_cast<unsigned long>(stats.fills),
+         static_cast<unsigned long>(stats.images), static_cast<unsigned long>(stats.text),
+         static_cast<unsigned long>(stats.commands), sleepPercent);
+}
+
+
+/*************************************************************
+************************* SCENARIOS **************************
+**************************************************************/
+
+void test_boot() {
+  bootFirmware();
+  TEST_ASSERT_EQUAL_UINT32(levelToDuty(255), halLedcDuty(RED_CHANNEL)); // first light is the saved step (RED)
+  TEST_ASSERT_EQUAL_UINT32(0, halLedcDuty(GREEN_CHANNEL));
+  TEST_ASSERT_TRUE(displayReady.load());
+
+  startMeasuring(); // leave out the self test and the static layout
+  runFor(100);
+  reportScenario("boot");
+
+  // The first snapshot draws all three fields as cached labels, then the history and the swatch
+  const DisplayStats &stats = halDisplayStats();
+  TEST_ASSERT_EQUAL_UINT32(REDRAW_IMAGES(3), stats.images);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.text);
+  TEST_ASSERT_EQUAL_UINT32(HISTORY_LENGTH + 2, stats.fills);
+}
+
+void test_auto_mode_hours() {
+  bootFirmware();
+  runFor(100); // first snapshot
+  startMeasuring();
+  uint32_t updatesBefore = halLedcUpdates(RED_CHANNEL);
+  int64_t sleepBefore = halSleepTimeUs();
+
+  runFor(SIM_AUTO_HOURS * 3600UL * 1000UL);
+  reportScenario("auto_hours");
+
+  // One step per second on the fixed schedule - none lost or added over the whole run
+  const uint32_t expectedSteps = SIM_AUTO_HOURS * 3600UL;
+  uint32_t steps = halLedcUpdates(RED_CHANNEL) - updatesBefore;
+  TEST_ASSERT_EQUAL_UINT32(expectedSteps, steps);
+  TEST_ASSERT_EQUAL_INT(static_cast<int>(expectedSteps % sequences[0].length), currentStep);
+
+  // Each step redraws the colour label, pushes one history strip (one scroll command) and refills the swatch
+  const DisplayStats &stats = halDisplayStats();
+  TEST_ASSERT_EQUAL_UINT32(steps, stats.images);
+  TEST_ASSERT_EQUAL_UINT32(steps * 2, stats.fills);
+  TEST_ASSERT_EQUAL_UINT32(steps, stats.commands);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.text);
+  TEST_ASSERT_TRUE(stats.pixels == static_cast<uint64_t>(steps) * STEP_PIXELS);
+
+  // Between steps the chip is in light sleep
+  TEST_ASSERT_TRUE((halSleepTimeUs() - sleepBefore) * 10 > measuredTimeUs() * 9);
+}
+
+void test_fade_mode() {
+  bootFirmware();
+  runFor(100);
+  pressButton(SIM_LONG_PRESS_HOLD, AUTO_COLOUR_PERIOD); // auto -> fade, then wait for the first fade to start
+  TEST_ASSERT_TRUE(currentState == State::Colour_CHANGE_FADE);
+
+  startMeasuring();
+  uint32_t updatesBefore = halLedcUpdates(RED_CHANNEL);
+  uint32_t sleepsBefore = halSleepCount();
+  runFor(SIM_FADE_TIME);
+  reportScenario("fade");
+
+  // The fade timer writes the LED at FADE_FRAME_INTERVAL, the swatch follows at the display frame rate
+  const uint32_t steps = SIM_FADE_TIME / AUTO_COLOUR_PERIOD;
+  const uint32_t framesPerStep = AUTO_COLOUR_PERIOD / SWATCH_FRAME_INTERVAL;
+  TEST_ASSERT_TRUE(halLedcUpdates(RED_CHANNEL) - updatesBefore >= (steps - 1) * (AUTO_COLOUR_PERIOD / FADE_FRAME_INTERVAL));
+
+  const DisplayStats &stats = halDisplayStats();
+  uint32_t swatchFills = stats.fills - steps; // the rest fill history strips
+  TEST_ASSERT_TRUE(swatchFills > steps * framesPerStep / 2);
+  TEST_ASSERT_TRUE(swatchFills <= (steps + 1) * (framesPerStep + 2));
+  TEST_ASSERT_EQUAL_UINT32(sleepsBefore, halSleepCount()); // a running fade keeps the chip awake
+}
+
+void test_manual_presses() {
+  bootFirmware();
+  runFor(100);
+  pressButton(SIM_LONG_PRESS_HOLD, 500); // auto -> fade
+  pressButton(SIM_LONG_PRESS_HOLD, 500); // fade -> manual
+  TEST_ASSERT_TRUE(currentState == State::Colour_CHANGE_MANUAL);
+  runFor(1100); // let the last fade finish
+
+  startMeasuring();
+  int startStep = currentStep;
+  for (int i = 0; i < SIM_PRESS_COUNT; i++) {
+    pressButton(SIM_PRESS_HOLD, SIM_PRESS_SPACING - SIM_PRESS_HOLD);
+  }
+  runFor(SETTINGS_COMMIT_DELAY + 1000);
+  reportScenario("manual_presses");
+
+  TEST_ASSERT_EQUAL_INT((startStep + SIM_PRESS_COUNT) % sequences[0].length, currentStep);
+
+  // Each press steps the colour on press-down, so one snapshot redraws the Button and Colour fields, with one
+  // history strip, one scroll command and one swatch fill; the release redraws the Button field again - the Mode
+  // field is never touched
+  const DisplayStats &stats = halDisplayStats();
+  TEST_ASSERT_EQUAL_UINT32(SIM_PRESS_COUNT * (REDRAW_IMAGES(2) + REDRAW_IMAGES(1)), stats.images);
+  TEST_ASSERT_EQUAL_UINT32(SIM_PRESS_COUNT * 2, stats.fills);
+  TEST_ASSERT_EQUAL_UINT32(SIM_PRESS_COUNT, stats.commands);
+  TEST_ASSERT_TRUE(stats.pixels == static_cast<uint64_t>(SIM_PRESS_COUNT) * (STEP_PIXELS + REDRAW_PIXELS(2)));
+
+  // The mode changes and the whole burst of presses end up as one flash write
+  TEST_ASSERT_EQUAL_UINT32(1, halNvsWrites());
+}
+
+void test_rotation() {
+  bootFirmware();
+  runFor(100);
+  pressButton(SIM_LONG_PRESS_HOLD, 500); // auto -> fade
+  pressButton(SIM_LONG_PRESS_HOLD, 500); // fade -> manual, so no colour steps land in the measurement
+  runFor(1100);
+
+  const uint8_t rotations[] = {ROTATION_LANDSCAPE, ROTATION_PORTRAIT};
+  for (uint8_t rotation : rotations) {
+    startMeasuring();
+    postEvent(EventType::SET_ROTATION, rotation);
+    runFor(100);
+    reportScenario(rotation == ROTATION_LANDSCAPE ? "rotate_landscape" : "rotate_portrait");
+
+    TEST_ASSERT_EQUAL_INT(rotation, layout.rotation);
+    TEST_ASSERT_EQUAL_INT(rotation == ROTATION_LANDSCAPE ? TFT_HEIGHT : TFT_WIDTH, tft.width());
+    TEST_ASSERT_EQUAL_INT(rotation, settings.rotation);
+
+    // One clear of everything but the history, one blit per static widget and field, then the history strips
+    // and the swatch - nothing is printed from the font
+    const DisplayStats &stats = halDisplayStats();
+    const Rect &swatch = layout.widgets[WIDGET_SWATCH];
+    TEST_ASSERT_EQUAL_UINT32(STATIC_WIDGET_COUNT + REDRAW_IMAGES(3), stats.images);
+    TEST_ASSERT_EQUAL_UINT32(HISTORY_LENGTH + 2, stats.fills);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.text);
+    TEST_ASSERT_TRUE(stats.pixels == static_cast<uint64_t>(TFT_WIDTH) * HISTORY_Y + TITLE_WIDTH * TITLE_HEIGHT +
+                                         3 * FIELD_X * FIELD_HEIGHT + REDRAW_PIXELS(3) + TFT_WIDTH * HISTORY_HEIGHT +
+                                         swatch.w * swatch.h);
+  }
+}
+
+
+void test_brightness() {
+  bootFirmware();
+  runFor(100); // double clicks step the brightness in auto mode (manual mode keeps presses for the colour)
+
+  const uint8_t expected[] = {191, 127, 63, 255}; // each double click dims one step, then wraps back to full
+  for (uint8_t brightness : expected) {
+    startMeasuring();
+    pressButton(SIM_PRESS_HOLD, SIM_CLICK_GAP);
+    pressButton(SIM_PRESS_HOLD, SIM_PRESS_SPACING);
+    reportScenario("double_click");
+
+    TEST_ASSERT_EQUAL_INT(brightness, settings.brightness);
+    TEST_ASSERT_TRUE(currentState == State::Colour_CHANGE_AUTO);
+
+    // The LED is scaled in lightness (the same colour levels, dimmed), and the backlight follows
+    auto scaled = [brightness](uint8_t level) {
+      return levelToDuty(static_cast<uint8_t>((level * brightness + 127) / 255));
+    };
+    TEST_ASSERT_EQUAL_UINT32(scaled(currentRGB.r), halLedcDuty(RED_CHANNEL));
+    TEST_ASSERT_EQUAL_UINT32(scaled(currentRGB.g), halLedcDuty(GREEN_CHANNEL));
+    TEST_ASSERT_EQUAL_UINT32(scaled(currentRGB.b), halLedcDuty(BLUE_CHANNEL));
+    TEST_ASSERT_EQUAL_UINT32(levelToDuty(brightness), halLedcDuty(BACKLIGHT_CHANNEL));
+  }
+
+  // A triple click goes straight back to full brightness
+  pressButton(SIM_PRESS_HOLD, SIM_CLICK_GAP);
+  pressButton(SIM_PRESS_HOLD, SIM_PRESS_SPACING);
+  TEST_ASSERT_EQUAL_INT(191, settings.brightness);
+  pressButton(SIM_PRESS_HOLD, SIM_CLICK_GAP);
+  pressButton(SIM_PRESS_HOLD, SIM_CLICK_GAP);
+  pressButton(SIM_PRESS_HOLD, SIM_PRESS_SPACING);
+  TEST_ASSERT_EQUAL_INT(255, settings.brightness);
+}
+
+void test_manual_gestures() {
+  bootFirmware();
+  runFor(100);
+  pressButton(SIM_LONG_PRESS_HOLD, 500); // auto -> fade
+  pressButton(SIM_LONG_PRESS_HOLD, 500); // fade -> manual
+  runFor(1100);
+
+  // Manual mode has no multi-click to wait out, so the colour changes on press-down
+  int step = currentStep;
+  uint32_t updatesBefore = halLedcUpdates(RED_CHANNEL);
+  halSchedulePin(BUTTON_PIN, LOW, halNowUs());
+  runFor(SIM_PRESS_LATENCY);
+  TEST_ASSERT_EQUAL_INT((step + 1) % sequences[0].length, currentStep);
+  TEST_ASSERT_EQUAL_UINT32(updatesBefore + 1, halLedcUpdates(RED_CHANNEL));
+  halSchedulePin(BUTTON_PIN, HIGH, halNowUs() + SIM_PRESS_HOLD * 1000);
+  runFor(SIM_PRESS_SPACING);
+  TEST_ASSERT_EQUAL_INT((step + 1) % sequences[0].length, currentStep); // the release doesn't step again
+
+  // A double press held scrolls the colours: one step per press, then one per repeat interval after the delay,
+  // and its long press doesn't change the mode
+  step = currentStep;
+  pressButton(SIM_PRESS_HOLD, SIM_CLICK_GAP);
+  pressButton(SIM_REPEAT_HOLD, SIM_PRESS_SPACING);
+  const int repeats = 1 + (SIM_REPEAT_HOLD - GESTURE_REPEAT_DELAY) / GESTURE_REPEAT_INTERVAL;
+  TEST_ASSERT_EQUAL_INT((step + 2 + repeats) % sequences[0].length, currentStep);
+  TEST_ASSERT_TRUE(currentState == State::Colour_CHANGE_MANUAL);
+
+  // A single long press still leaves manual mode, and undoes its press-down step
+  step = currentStep;
+  pressButton(SIM_LONG_PRESS_HOLD, 500);
+  TEST_ASSERT_TRUE(currentState == State::Colour_CHANGE_AUTO);
+  TEST_ASSERT_EQUAL_INT(step, currentStep);
+}
+
+void test_phase_nudge() {
+  bootFirmware();
+  runFor(100);
+  uint32_t updatesBefore = halLedcUpdates(RED_CHANNEL);
+  int delayBefore = static_cast<int>(nextAutoStepDelay());
+  nudgeAutoColour(SIM_PHASE_NUDGE * 1000); // what a follower does with a beacon's phase error
+
+  // The step already armed keeps its deadline, each one after it comes at most AUTO_SLEW_PER_MILLE early
+  const int slewMs = AUTO_COLOUR_PERIOD * AUTO_SLEW_PER_MILLE / 1000;
+  runFor(AUTO_COLOUR_PERIOD);
+  TEST_ASSERT_INT_WITHIN(1, delayBefore - slewMs, static_cast<int>(nextAutoStepDelay()));
+
+  // Once the whole nudge is worked off the schedule runs at its normal period again
+  const int catchUpSteps = SIM_PHASE_NUDGE / slewMs;
+  runFor((catchUpSteps + 2) * AUTO_COLOUR_PERIOD);
+  TEST_ASSERT_INT_WITHIN(1, delayBefore - SIM_PHASE_NUDGE, static_cast<int>(nextAutoStepDelay()));
+  TEST_ASSERT_EQUAL_UINT32(updatesBefore + catchUpSteps + 3, halLedcUpdates(RED_CHANNEL)); // no step skipped
+
+  // Restarting the schedule drops a correction that is still pending
+  nudgeAutoColour(SIM_PHASE_NUDGE * 1000);
+  startAutoColour();
+  delayBefore = static_cast<int>(nextAutoStepDelay());
+  runFor(AUTO_COLOUR_PERIOD * 3 / 2);
+  TEST_ASSERT_INT_WITHIN(1, delayBefore - AUTO_COLOUR_PERIOD / 2, static_cast<int>(nextAutoStepDelay()));
+}
+
+void test_pattern() {
+  // The example in pattern.h - blink red twice, then fade to blue and back forever
+  const uint8_t blinkThenFade[] = {'P', 'T', PATTERN_VERSION, 0x01, 0xFF, 0x00, 0x00, 0x03, 0xF4, 0x01,
+                                   0x01, 0x00, 0x00, 0x00, 0x03, 0xF4, 0x01, 0x04, 0x00, 0x01,
+                                   0x02, 0x00, 0x00, 0xFF, 0xE8, 0x03, 0x02, 0xFF, 0x00, 0x00, 0xE8, 0x03,
+                                   0x04, 0x05, 0x00};
+  static Pattern decoded;
+  TEST_ASSERT_TRUE(decodePattern(blinkThenFade, sizeof(blinkThenFade), decoded));
+  TEST_ASSERT_EQUAL_INT(8, decoded.length);
+
+  // Rejected on load: a bad header, a zero wait, a jump off the end, a truncated operand and a loop that never waits
+  const uint8_t badHeader[] = {'P', 'X', PATTERN_VERSION, 0x03, 0x01, 0x00};
+  const uint8_t zeroWait[] = {'P', 'T', PATTERN_VERSION, 0x03, 0x00, 0x00};
+  const uint8_t badTarget[] = {'P', 'T', PATTERN_VERSION, 0x03, 0x01, 0x00, 0x04, 0x02, 0x00};
+  const uint8_t truncated[] = {'P', 'T', PATTERN_VERSION, 0x02, 0xFF, 0x00, 0x00, 0xE8};
+  const uint8_t spin[] = {'P', 'T', PATTERN_VERSION, 0x03, 0x01, 0x00, 0x01, 0xFF, 0x00, 0x00, 0x04, 0x01, 0x00};
+  TEST_ASSERT_FALSE(decodePattern(badHeader, sizeof(badHeader), decoded));
+  TEST_ASSERT_FALSE(decodePattern(zeroWait, sizeof(zeroWait), decoded));
+  TEST_ASSERT_FALSE(decodePattern(badTarget, sizeof(badTarget), decoded));
+  TEST_ASSERT_FALSE(decodePattern(truncated, sizeof(truncated), decoded));
+  TEST_ASSERT_FALSE(decodePattern(spin, sizeof(spin), decoded));
+
+  // Pattern mode can't be entered until there is a pattern
+  bootFirmware();
+  runFor(100);
+  postEvent(EventType::SET_MODE, static_cast<int32_t>(State::Colour_CHANGE_PATTERN));
+  runFor(1);
+  TEST_ASSERT_TRUE(currentState == State::Colour_CHANGE_AUTO);
+
+  // Loaded from LittleFS at boot, then entered with a command - the first instruction runs straight away
+  halWriteFile(PATTERN_FILE, blinkThenFade, sizeof(blinkThenFade));
+  bootFirmware();
+  runFor(100);
+  postEvent(EventType::SET_MODE, static_cast<int32_t>(State::Colour_CHANGE_PATTERN));
+  runFor(1);
+  TEST_ASSERT_TRUE(currentState == State::Colour_CHANGE_PATTERN);
+  TEST_ASSERT_EQUAL_UINT32(levelToDuty(255), halLedcDuty(RED_CHANNEL));
+  TEST_ASSERT_EQUAL_UINT32(0, halLedcDuty(BLUE_CHANNEL));
+  runFor(500);
+  TEST_ASSERT_EQUAL_UINT32(0, halLedcDuty(RED_CHANNEL)); // off between the blinks
+  runFor(1000);
+  TEST_ASSERT_EQUAL_UINT32(0, halLedcDuty(RED_CHANNEL)); // the second blink is over too
+
+  // The fades alternate every second on the fixed schedule, so after minutes they are still in phase
+  startMeasuring();
+  runFor(SIM_PATTERN_TIME + 999); // halfway into a fade to blue (they start 2 s after the pattern, every 2 s)
+  reportScenario("pattern");
+  TEST_ASSERT_EQUAL_UINT8(255, currentRGB.b);
+  TEST_ASSERT_EQUAL_UINT8(0, currentRGB.r);
+  runFor(1000);
+  TEST_ASSERT_EQUAL_UINT8(255, currentRGB.r);
+  TEST_ASSERT_EQUAL_UINT8(0, currentRGB.b);
+
+  // Pushed at runtime: green until the button is held, red while it is (checked every 100 ms)
+  const uint8_t buttonBranch[] = {'P', 'T', PATTERN_VERSION, 0x01, 0x00, 0xFF, 0x00, 0x03, 0x64, 0x00, 0x05, 0x04,
+                                  0x04, 0x00, 0x00, 0x01, 0xFF, 0x00, 0x00, 0x03, 0x64, 0x00, 0x04, 0x02, 0x00};
+  TEST_ASSERT_TRUE(stagePattern(buttonBranch, sizeof(buttonBranch)));
+  runFor(1);
+  TEST_ASSERT_EQUAL_UINT32(levelToDuty(255), halLedcDuty(GREEN_CHANNEL));
+  halSchedulePin(BUTTON_PIN, LOW, halNowUs());
+  runFor(SIM_PATTERN_HOLD);
+  TEST_ASSERT_EQUAL_UINT32(levelToDuty(255), halLedcDuty(RED_CHANNEL));
+  TEST_ASSERT_EQUAL_UINT32(0, halLedcDuty(GREEN_CHANNEL));
+  halSchedulePin(BUTTON_PIN, HIGH, halNowUs());
+  runFor(SIM_PATTERN_HOLD);
+  TEST_ASSERT_EQUAL_UINT32(levelToDuty(255), halLedcDuty(GREEN_CHANNEL));
+  TEST_ASSERT_TRUE(currentState == State::Colour_CHANGE_PATTERN);
+
+  halWriteFile(PATTERN_FILE, nullptr, 0);
+}
+
+void test_telemetry() {
+  // A power-on starts the log afresh with the boot record
+  bootFirmware();
+  TEST_ASSERT_EQUAL_UINT32(1, telemetryCount());
+  TEST_ASSERT_EQUAL_UINT8(TELEMETRY_BOOT, telemetryType(telemetryRecord(0)));
+  TEST_ASSERT_EQUAL_UINT8(ESP_RST_POWERON, telemetryValue(telemetryRecord(0)));
+
+  // Each auto step is logged once, as the colour change (the timer's step events are left out)
+  runFor(AUTO_COLOUR_PERIOD * 3 + 100);
+  uint32_t colourChanges = 0;
+  for (uint32_t i = 0; i < telemetryCount(); i++) {
+    uint8_t type = telemetryType(telemetryRecord(i));
+    TEST_ASSERT_TRUE(type != static_cast<uint8_t>(EventType::AUTO_STEP));
+    colourChanges += (type == static_cast<uint8_t>(EventType::COLOUR_CHANGED));
+  }
+  TEST_ASSERT_EQUAL_UINT32(4, colourChanges); // the first light's and three steps
+  uint32_t lastStep = telemetryRecord(telemetryCount() - 1);
+  TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(EventType::COLOUR_CHANGED), telemetryType(lastStep));
+  TEST_ASSERT_EQUAL_UINT8(currentStep, telemetryValue(lastStep));
+  TEST_ASSERT_INT_WITHIN(17, AUTO_COLOUR_PERIOD * 3, static_cast<int>(telemetryTimeMs(lastStep))); // 16.4 ms ticks
+
+  // A press is logged as its two edges, stamped with the time of the edge
+  uint32_t before = telemetryCount();
+  int64_t pressUs = halNowUs();
+  pressButton(SIM_PRESS_HOLD, 50);
+  uint32_t press = telemetryRecord(before);
+  TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(EventType::BUTTON_EDGE), telemetryType(press));
+  TEST_ASSERT_EQUAL_UINT8(1, telemetryValue(press));
+  TEST_ASSERT_EQUAL_UINT32(static_cast<uint32_t>(pressUs >> TELEMETRY_TICK_SHIFT) & 0xFFFF, press & 0xFFFF);
+  TEST_ASSERT_EQUAL_UINT8(0, telemetryValue(telemetryRecord(before + 1)));
+
+  // The log outlives a crash, with the reset reason in the new boot record
+  uint32_t kept = telemetryCount();
+  bootFirmware(ESP_RST_PANIC);
+  TEST_ASSERT_EQUAL_UINT32(kept + 1, telemetryCount());
+  TEST_ASSERT_EQUAL_UINT32(lastStep, telemetryRecord(before - 1));
+  TEST_ASSERT_EQUAL_UINT8(TELEMETRY_BOOT, telemetryType(telemetryRecord(kept)));
+  TEST_ASSERT_EQUAL_UINT8(ESP_RST_PANIC, telemetryValue(telemetryRecord(kept)));
+
+  // Once full, each record replaces the oldest
+  runFor(SIM_TELEMETRY_STEPS * AUTO_COLOUR_PERIOD + 100);
+  TEST_ASSERT_EQUAL_UINT32(TELEMETRY_SIZE, telemetryCount());
+  TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(EventType::COLOUR_CHANGED),
+                          telemetryType(telemetryRecord(TELEMETRY_SIZE - 1)));
+  TEST_ASSERT_EQUAL_UINT8(currentStep, telemetryValue(telemetryRecord(TELEMETRY_SIZE - 1)));
+
+  // A power-on clears it
+  bootFirmware();
+  TEST_ASSERT_EQUAL_UINT32(1, telemetryCount());
+}
+
+void test_health() {
+  bootFirmware();
+  runFor(AUTO_COLOUR_PERIOD * 3 + 100);
+  for (const HealthMonitor &monitor : healthMonitors) {
+    TEST_ASSERT_EQUAL_UINT32(0, monitor.misses.load());
+  }
+
+  // A slow panel makes every step's frame overrun - a few in a row and the rendering degrades
+  halSetPanelDelayUs(HEALTH_FRAME_DEADLINE * 1000); // any frame of two operations or more is late
+  runFor(AUTO_COLOUR_PERIOD * (HEALTH_DEGRADE_MISSES - 1));
+  TEST_ASSERT_FALSE(displayDegraded.load());
+  runFor(AUTO_COLOUR_PERIOD);
+  TEST_ASSERT_TRUE(displayDegraded.load());
+  TEST_ASSERT_EQUAL_UINT32(HEALTH_DEGRADE_MISSES, healthMonitors[HEALTH_FRAME].misses.load());
+  TEST_ASSERT_TRUE(healthMonitors[HEALTH_FRAME].worstUs.load() > HEALTH_FRAME_DEADLINE * 1000);
+
+  // Degraded frames are the changed field as text - no label bitmap, sprite, history or swatch
+  runFor(AUTO_COLOUR_PERIOD); // the first one also blanks the swatch and history
+  startMeasuring();
+  runFor(AUTO_COLOUR_PERIOD);
+  const DisplayStats &stats = halDisplayStats();
+  TEST_ASSERT_EQUAL_UINT32(0, stats.images);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.text);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.fills);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.commands);
+  TEST_ASSERT_TRUE(displayDegraded.load()); // still late, so it stays degraded
+
+  // Once the panel is fast again, enough frames in a row on time bring full rendering back
+  halSetPanelDelayUs(0);
+  runFor(AUTO_COLOUR_PERIOD * HEALTH_RECOVER_FRAMES);
+  TEST_ASSERT_FALSE(displayDegraded.load());
+  startMeasuring();
+  runFor(AUTO_COLOUR_PERIOD);
+  TEST_ASSERT_EQUAL_UINT32(REDRAW_IMAGES(1), stats.images);
+  TEST_ASSERT_EQUAL_UINT32(HISTORY_LENGTH + 2, stats.fills); // the history and swatch are repainted
+
+  // The loop task's deadlines count their misses the same way
+  uint32_t inputMisses = healthMonitors[HEALTH_INPUT].misses.load();
+  TEST_ASSERT_TRUE(checkDeadline(HEALTH_INPUT, halNowUs() - HEALTH_INPUT_DEADLINE * 1000));
+  TEST_ASSERT_FALSE(checkDeadline(HEALTH_INPUT, halNowUs() - HEALTH_INPUT_DEADLINE * 1000 - 1));
+  TEST_ASSERT_EQUAL_UINT32(inputMisses + 1, healthMonitors[HEALTH_INPUT].misses.load());
+}
+
+/*************************************************************
+*********************** MAIN FUNCTIONS ***********************
+**************************************************************/
+
+void setUp() {}
+
+void tearDown() {}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_boot);
+  RUN_TEST(test_auto_mode_hours);
+  RUN_TEST(test_fade_mode);
+  RUN_TEST(test_manual_presses);
+  RUN_TEST(test_rotation);
+  RUN_TEST(test_brightness);
+  RUN_TEST(test_manual_gestures);
+  RUN_TEST(test_phase_nudge);
+  RUN_TEST(test_pattern);
+  RUN_TEST(test_telemetry);
+  RUN_TEST(test_health);
+  return UNITY_END();
+}